@@ -10,6 +10,31 @@
 #include <cstdlib>
 #include <ctime>
 #include <iterator>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <array>
+#include <set>
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include <cmath>
+#include <complex>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
 // Simulation constants
@@ -24,8 +49,93 @@ class Organism;
 class Ant;
 class Doodlebug;
 
+/**
+ * OrgHandle: 32-bit reference to an organism in an OrgSlots table,
+ * the slot index in the upper 27 bits and a generation in the lower 5.
+ * Generations start at 1, so 0 is never issued and means "no organism".
+ */
+typedef uint32_t OrgHandle;
+static const OrgHandle NO_ORG = 0;
+
+/*
+ * Neighborhood, fixed at compile time: 4 (von Neumann, the default) or
+ * 8 (Moore, build with -DNEIGHBORHOOD=8). It applies to moving, eating
+ * and breeding in every engine, including the reference one.
+ */
+#ifndef NEIGHBORHOOD
+#define NEIGHBORHOOD 4
+#endif
+#if NEIGHBORHOOD != 4 && NEIGHBORHOOD != 8
+#error "NEIGHBORHOOD must be 4 or 8"
+#endif
+
+// Neighbor offsets, in the order getNeighbors returns them
+static const int NUM_DIRS = NEIGHBORHOOD;
+static const int DIRS[NUM_DIRS][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}
+#if NEIGHBORHOOD == 8
+                                      ,
+                                      {1, 1}, {-1, -1}, {1, -1}, {-1, 1}
+#endif
+};
+
+// Room for two direction masks (see World::neighborMasks)
+#if NEIGHBORHOOD == 8
+typedef uint16_t NeighborMask;
+#else
+typedef uint8_t NeighborMask;
+#endif
+
+/**
+ * Direction masks have bit d set for DIRS[d]. DIRS is laid out in
+ * opposite pairs, so d ^ 1 points back.
+ */
+static int directionCount(unsigned mask)
+{
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        n++;
+    return n;
+}
+
+/**
+ * The k-th set direction in mask, counting from bit 0
+ */
+static int nthDirection(unsigned mask, int k)
+{
+    for (; k > 0; k--)
+        mask &= mask - 1;
+    for (int d = 0;; d++)
+        if (mask & (1u << d))
+            return d;
+}
+
+/**
+ * A direction chosen uniformly from mask, or -1 (drawing nothing) if
+ * the mask is empty
+ */
+static int pickDirection(unsigned mask, mt19937 &gen)
+{
+    int n = directionCount(mask);
+    if (n == 0)
+        return -1;
+    return nthDirection(mask, uniform_int_distribution<int>(0, n - 1)(gen));
+}
+
+/**
+ * An ant's breed counter after `turns` turns in which it had no empty
+ * neighbor, so each turn only advanced the counter, resetting it on
+ * reaching breedAt
+ */
+static int idleBreedCount(int count, int turns, int breedAt)
+{
+    if (turns <= 0)
+        return count;
+    count = (count + 1 >= breedAt) ? 0 : count + 1;
+    return (count + turns - 1) % breedAt;
+}
+
 typedef vector<pair<int, int>> Directions;
-typedef vector<vector<Organism *>> OrgGrid;
+typedef vector<vector<OrgHandle>> OrgGrid;
 
 /**
  * Base class: Organism
@@ -36,18 +146,31 @@ protected:
     int x, y;
     int breedCount;
     char character;
+    uint32_t id;
+    OrgHandle handle;
 
 public:
     Organism(int x, int y, char ch = ' ')
-        : x(x), y(y), breedCount(0), character(ch) {}
+        : x(x), y(y), breedCount(0), character(ch), id(0), handle(NO_ORG) {}
 
     virtual ~Organism() {}
 
     virtual bool starve() { return false; }
 
+    virtual Organism *clone() const { return new Organism(*this); }
+
     void incBreed() { breedCount++; }
     void resetBreed() { breedCount = 0; }
-    int getBreedCount() { return breedCount; }
+    int getBreedCount() const { return breedCount; }
+    void setBreedCount(int n) { breedCount = n; }
+
+    char getCharacter() const { return character; }
+
+    uint32_t getId() const { return id; }
+    void setId(uint32_t n) { id = n; }
+
+    OrgHandle getHandle() const { return handle; }
+    void setHandle(OrgHandle h) { handle = h; }
 
     int getX() const { return x; }
     int getY() const { return y; }
@@ -72,11 +195,18 @@ public:
  */
 class Ant : public Organism
 {
+private:
+    int energy; // only used with the food layer (World::setFood)
+
 public:
     Ant(int x, int y)
-        : Organism(x, y, 'o') {}
+        : Organism(x, y, 'o'), energy(0) {}
 
     void update(World &w) override;
+    Ant *clone() const override { return new Ant(*this); }
+
+    int getEnergy() const { return energy; }
+    void setEnergy(int e) { energy = e; }
 };
 
 /**
@@ -92,341 +222,4939 @@ public:
         : Organism(x, y, 'X'), starveCount(0) {}
 
     void update(World &w) override;
+    Doodlebug *clone() const override { return new Doodlebug(*this); }
     bool starve() override
     {
         return (starveCount >= DOODLE_STARVE);
     }
+
+    int getStarveCount() const { return starveCount; }
+    void setStarveCount(int n) { starveCount = n; }
 };
 
 /**
- * World class
+ * DensityPyramid: per-block ant and doodlebug counts for every
+ * power-of-two zoom level. Level k counts 2^k x 2^k blocks of cells
+ * (level 0 is the grid itself and is not stored). Counts are kept
+ * current on each cell change, so a zoomed-out view reads one entry
+ * per screen character instead of scanning the world.
  */
-class World
+class DensityPyramid
 {
 private:
-    int size, age;
-    OrgGrid grid;
-    vector<Organism *> allOrgs;
+    struct Level
+    {
+        int dim; // blocks per side
+        vector<int> ants;
+        vector<int> doodles;
+    };
+    vector<Level> levels; // levels[k - 1] holds level k
+    int antTotal = 0, doodleTotal = 0;
 
 public:
-    World(int size)
-        : size(size), age(0),
-          grid(size, vector<Organism *>(size, nullptr))
+    void reset(int size)
     {
-        srand(static_cast<unsigned>(time(nullptr)));
+        levels.clear();
+        antTotal = doodleTotal = 0;
+        for (int k = 1; (1 << (k - 1)) < size; k++)
+        {
+            int dim = (size + (1 << k) - 1) >> k;
+            levels.push_back({dim, vector<int>(dim * dim, 0), vector<int>(dim * dim, 0)});
+        }
     }
 
-    ~World()
+    int maxLevel() const { return static_cast<int>(levels.size()); }
+
+    /**
+     * Adds delta to the counters of every block containing (x, y)
+     * for the species drawn as ch ('o' or 'X').
+     */
+    void add(int x, int y, char ch, int delta)
     {
-        for (int x = 0; x < size; x++)
+        if (ch == 'o')
+            antTotal += delta;
+        else if (ch == 'X')
+            doodleTotal += delta;
+        for (size_t i = 0; i < levels.size(); i++)
         {
-            for (int y = 0; y < size; y++)
-            {
-                delete grid[x][y];
-            }
+            Level &l = levels[i];
+            int k = static_cast<int>(i) + 1;
+            int idx = (x >> k) * l.dim + (y >> k);
+            if (ch == 'o')
+                l.ants[idx] += delta;
+            else if (ch == 'X')
+                l.doodles[idx] += delta;
         }
     }
 
-    bool inBounds(int x, int y) const
+    int ants(int level, int bx, int by) const
     {
-        return (x >= 0 && x < size && y >= 0 && y < size);
+        const Level &l = levels[level - 1];
+        return l.ants[bx * l.dim + by];
     }
 
-    Organism *getCell(int x, int y) const
+    int doodles(int level, int bx, int by) const
     {
-        if (!inBounds(x, y))
-            return nullptr;
-        return grid[x][y];
+        const Level &l = levels[level - 1];
+        return l.doodles[bx * l.dim + by];
     }
 
-    void setCell(int x, int y, Organism *org)
+    int totalAnts() const { return antTotal; }
+    int totalDoodles() const { return doodleTotal; }
+};
+
+/**
+ * Viewport: the window of the world shown on screen.
+ * Each screen character covers 2^zoom x 2^zoom cells.
+ */
+struct Viewport
+{
+    int top, left;  // block coordinates of the upper-left character
+    int rows, cols; // screen size in characters
+    int zoom;
+};
+
+/**
+ * Splits rows [0, rows) into bands and runs fn(band, begin, end) for
+ * each on its own thread. Falls back to the calling thread for one band.
+ */
+void parallelBands(int rows, int bands, const function<void(int, int, int)> &fn)
+{
+    bands = max(1, min(bands, rows));
+    int per = (rows + bands - 1) / bands;
+    if (bands == 1)
     {
-        if (!inBounds(x, y))
-            return;
-        grid[x][y] = org;
+        fn(0, 0, rows);
+        return;
+    }
+    vector<thread> workers;
+    for (int b = 0; b < bands; b++)
+    {
+        int begin = b * per;
+        int end = min(rows, begin + per);
+        workers.emplace_back(fn, b, begin, end);
     }
+    for (auto &t : workers)
+        t.join();
+}
 
-    /**
-     * Removes occupant from the grid and from allOrgs
-     */
-    void deleteCell(int x, int y)
+/**
+ * Number of row bands to use for parallel passes
+ */
+int defaultBands()
+{
+    unsigned n = thread::hardware_concurrency();
+    return n ? static_cast<int>(n) : 1;
+}
+
+/**
+ * SplitMix64 finalizer: a fast, well-distributed 64-bit mix
+ */
+static inline uint64_t mix64(uint64_t z)
+{
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Counter-based random number: a pure function of its inputs, so any
+ * thread can draw the number for (seed, step, stream, key) in any order
+ */
+static inline uint64_t counterRandom(uint64_t seed, uint64_t step, uint64_t stream, uint64_t key)
+{
+    return mix64(mix64(mix64(seed ^ mix64(stream)) ^ step) ^ key);
+}
+
+/*
+ * Checkpoint byte helpers: little-endian words and LEB128 varints.
+ */
+static void putU32(vector<uint8_t> &out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+static bool getU32(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+    if (end - p < 4)
+        return false;
+    v = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    p += 4;
+    return true;
+}
+
+// Floats travel as their IEEE bit patterns
+static void putFloat(vector<uint8_t> &out, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, 4);
+    putU32(out, v);
+}
+
+static bool getFloat(const uint8_t *&p, const uint8_t *end, float &f)
+{
+    uint32_t v;
+    if (!getU32(p, end, v))
+        return false;
+    memcpy(&f, &v, 4);
+    return true;
+}
+
+static void putVarint(vector<uint8_t> &out, uint32_t v)
+{
+    while (v >= 0x80)
     {
-        if (!inBounds(x, y))
-            return;
-        Organism *toDelete = grid[x][y];
-        if (toDelete)
-        {
-            // Remove from our master list
-            auto it = find(allOrgs.begin(), allOrgs.end(), toDelete);
-            if (it != allOrgs.end())
-            {
-                allOrgs.erase(it);
-            }
-            delete toDelete;
-            grid[x][y] = nullptr;
-        }
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
     }
+    out.push_back(static_cast<uint8_t>(v));
+}
 
-    Directions getNeighbors(int x, int y) const
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7)
     {
-        static int dirs[4][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
-        Directions result;
-        for (auto &d : dirs)
-        {
-            int nx = x + d[0];
-            int ny = y + d[1];
-            if (inBounds(nx, ny))
-            {
-                result.push_back({nx, ny});
-            }
-        }
-        return result;
+        uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
     }
+    return false;
+}
 
-    // Create an Ant and track it in allOrgs
-    void createAnt(int x, int y)
+/**
+ * Run-length encodes the bitplane "cell is of kind k" of n packed cells
+ * as alternating run lengths, starting with a (possibly empty) run of
+ * zeros. The plane is never built: runs end where a cell's match differs
+ * from the cell before, found 16 cells per SSE2 compare.
+ */
+static void putKindPlane(vector<uint8_t> &out, const uint8_t *cells, size_t n, uint8_t k)
+{
+    unsigned current = 0; // whether the open run matches
+    size_t runStart = 0, i = 0;
+#ifdef __SSE2__
+    const __m128i kind = _mm_set1_epi8(static_cast<char>(k));
+    for (; i + 16 <= n; i += 16)
     {
-        if (!getCell(x, y))
+        unsigned match = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + i)), kind));
+        unsigned changes = (match ^ ((match << 1) | current)) & 0xFFFF;
+        for (; changes; changes &= changes - 1)
         {
-            Ant *a = new Ant(x, y);
-            setCell(x, y, a);
-            allOrgs.push_back(a);
+            size_t at = i + __builtin_ctz(changes);
+            putVarint(out, static_cast<uint32_t>(at - runStart));
+            runStart = at;
         }
+        current = match >> 15;
     }
-
-    // Create a Doodlebug and track it in allOrgs
-    void createDoodlebug(int x, int y)
+#endif
+    for (; i < n; i++)
     {
-        if (!getCell(x, y))
+        unsigned match = cells[i] == k;
+        if (match != current)
         {
-            Doodlebug *d = new Doodlebug(x, y);
-            setCell(x, y, d);
-            allOrgs.push_back(d);
+            putVarint(out, static_cast<uint32_t>(i - runStart));
+            runStart = i;
+            current = match;
         }
     }
+    putVarint(out, static_cast<uint32_t>(n - runStart));
+}
 
-    /**
-     * Places the initial set of ants & doodles
-     */
-    void initialize()
+static bool getBitplane(const uint8_t *&p, const uint8_t *end, vector<uint8_t> &bits)
+{
+    size_t pos = 0;
+    uint8_t current = 0;
+    while (pos < bits.size())
     {
-        int placedAnts = 0;
-        int placedDoodles = 0;
+        uint32_t run;
+        if (!getVarint(p, end, run) || run > bits.size() - pos)
+            return false;
+        fill(bits.begin() + pos, bits.begin() + pos + run, current);
+        pos += run;
+        current ^= 1;
+    }
+    return true;
+}
+
+/**
+ * Counter streams are nibble-packed when every value fits in four
+ * bits (the usual case) and varint-coded otherwise.
+ */
+static void putCounters(vector<uint8_t> &out, const vector<uint32_t> &vals)
+{
+    bool small = all_of(vals.begin(), vals.end(), [](uint32_t v)
+                        { return v < 16; });
+    out.push_back(small ? 0 : 1);
+    if (!small)
+    {
+        for (uint32_t v : vals)
+            putVarint(out, v);
+        return;
+    }
+    for (size_t i = 0; i < vals.size(); i += 2)
+    {
+        uint8_t hi = (i + 1 < vals.size()) ? static_cast<uint8_t>(vals[i + 1]) : 0;
+        out.push_back(static_cast<uint8_t>(vals[i] | (hi << 4)));
+    }
+}
+
+static bool getCounters(const uint8_t *&p, const uint8_t *end, vector<uint32_t> &vals)
+{
+    if (p >= end)
+        return false;
+    uint8_t mode = *p++;
+    if (mode == 1)
+    {
+        for (auto &v : vals)
+            if (!getVarint(p, end, v))
+                return false;
+        return true;
+    }
+    size_t bytes = (vals.size() + 1) / 2;
+    if (mode != 0 || static_cast<size_t>(end - p) < bytes)
+        return false;
+    for (size_t i = 0; i < vals.size(); i++)
+        vals[i] = (p[i / 2] >> ((i & 1) * 4)) & 0x0f;
+    p += bytes;
+    return true;
+}
+
+/**
+ * EventRecord: one fixed-size entry of the binary event log.
+ * Cells are numbered x * size + y.
+ */
+enum EventType : uint8_t
+{
+    EVENT_ANT_BIRTH,
+    EVENT_DOODLE_BIRTH,
+    EVENT_ANT_DEATH,
+    EVENT_DOODLE_DEATH,
+    EVENT_PREDATION // cell = prey, parentCell = predator
+};
+
+static const uint32_t NO_CELL = 0xffffffffu;
+
+struct EventRecord
+{
+    uint32_t step;
+    uint32_t cell;
+    uint32_t parentCell; // NO_CELL when there is none
+    uint8_t type;
+    uint8_t pad[3];
+};
+
+/**
+ * EventLog: appends EventRecords to a binary file. Each emitting
+ * thread fills its own buffer; full buffers are handed to a writer
+ * thread so the simulation never waits on the disk.
+ */
+class EventLog
+{
+private:
+    static const size_t BUFFER_RECORDS = 4096;
+
+    ofstream out;
+    uint64_t serial; // unique per log, so a reused address never hits a stale cache
+    mutex lock;
+    condition_variable ready;
+    deque<vector<EventRecord>> pending;
+    map<thread::id, vector<EventRecord>> buffers;
+    bool closing;
+    thread writer;
 
-        while (placedDoodles < INIT_DOODLES)
+    vector<EventRecord> &localBuffer()
+    {
+        static thread_local pair<uint64_t, vector<EventRecord> *> cached(0, nullptr);
+        if (cached.first != serial)
         {
-            int x = rand() % size;
-            int y = rand() % size;
-            if (!getCell(x, y))
-            {
-                Doodlebug *d = new Doodlebug(x, y);
-                setCell(x, y, d);
-                allOrgs.push_back(d);
-                placedDoodles++;
-            }
+            lock_guard<mutex> guard(lock);
+            vector<EventRecord> &buf = buffers[this_thread::get_id()];
+            buf.reserve(BUFFER_RECORDS);
+            cached = {serial, &buf};
         }
+        return *cached.second;
+    }
 
-        while (placedAnts < INIT_ANTS)
+    void hand(vector<EventRecord> &buf)
+    {
+        if (buf.empty())
+            return;
+        lock_guard<mutex> guard(lock);
+        pending.push_back(move(buf));
+        buf.clear();
+        buf.reserve(BUFFER_RECORDS);
+        ready.notify_one();
+    }
+
+    void writeLoop()
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
         {
-            int x = rand() % size;
-            int y = rand() % size;
-            if (!getCell(x, y))
-            {
-                Ant *a = new Ant(x, y);
-                setCell(x, y, a);
-                allOrgs.push_back(a);
-                placedAnts++;
-            }
+            ready.wait(guard, [this]
+                       { return closing || !pending.empty(); });
+            if (pending.empty())
+                return;
+            vector<EventRecord> batch = move(pending.front());
+            pending.pop_front();
+            guard.unlock();
+            out.write(reinterpret_cast<const char *>(batch.data()),
+                      batch.size() * sizeof(EventRecord));
+            guard.lock();
         }
     }
 
-    /**
-     * We take a snapshot of allOrgs to avoid issues
-     * if an organism gets deleted/bred during iteration.
-     */
-    void update()
+public:
+    explicit EventLog(const string &path)
+        : out(path, ios::binary), closing(false)
     {
-        age++;
-        // Build a snapshot
-        vector<Organism *> snapshot = allOrgs;
-
-        // Shuffle snapshot to randomize update order
-        static random_device rd;
-        static mt19937 gen(rd());
-        shuffle(snapshot.begin(), snapshot.end(), gen);
+        static atomic<uint64_t> nextSerial(1);
+        serial = nextSerial++;
+        writer = thread(&EventLog::writeLoop, this);
+    }
 
-        // For each occupant in the snapshot
-        for (auto o : snapshot)
+    ~EventLog()
+    {
+        flush();
         {
-            // If it was removed in the middle (starved or eaten), skip
-            if (find(allOrgs.begin(), allOrgs.end(), o) == allOrgs.end())
-                continue;
-
-            o->update(*this);
+            lock_guard<mutex> guard(lock);
+            closing = true;
         }
+        ready.notify_one();
+        writer.join();
     }
 
-    friend ostream &operator<<(ostream &os, const World &w)
+    bool good() const { return static_cast<bool>(out); }
+
+    void emit(uint32_t step, uint8_t type, uint32_t cell, uint32_t parentCell)
     {
-        os << "World at iteration " << (w.age + 1) << ":\n";
-        for (int x = 0; x < w.size; x++)
+        vector<EventRecord> &buf = localBuffer();
+        EventRecord r = {step, cell, parentCell, type, {0, 0, 0}};
+        buf.push_back(r);
+        if (buf.size() >= BUFFER_RECORDS)
+            hand(buf);
+    }
+
+    /**
+     * Queues every partially filled buffer. Call only while no thread
+     * is emitting (e.g. between steps).
+     */
+    void flush()
+    {
+        vector<vector<EventRecord> *> all;
         {
-            for (int y = 0; y < w.size; y++)
-            {
-                if (w.grid[x][y])
-                    os << w.grid[x][y] << ' ';
-                else
-                    os << "- ";
-            }
-            os << "\n";
+            lock_guard<mutex> guard(lock);
+            for (auto &entry : buffers)
+                all.push_back(&entry.second);
         }
-        return os;
+        for (auto buf : all)
+            hand(*buf);
     }
 };
 
 /**
- * Ant::update(World&)
- * 1) Move (random)
- * 2) Breed if breedCount >= ANT_BREED
+ * LineageTable: append-only parent list indexed by organism ID.
+ * IDs are handed out in birth order, so a parent always has a smaller
+ * ID than its child and founders can be resolved in a single pass.
+ * Costs four bytes per birth. IDs are 32 bits, so after MAX_IDS births
+ * the table is full (see add). The list is kept in fixed-size chunks
+ * that copies of the table share: only the partly filled last chunk is
+ * copied, on the first add after the table was copied.
  */
-void Ant::update(World &w)
+class LineageTable
 {
-    // (1) Attempt to move
-    Directions neighbors = w.getNeighbors(getX(), getY());
-    static random_device rd;
-    static mt19937 gen(rd());
-    shuffle(neighbors.begin(), neighbors.end(), gen);
+private:
+    static const size_t CHUNK = 1024;
+    typedef array<uint32_t, CHUNK> Chunk;
+    vector<shared_ptr<Chunk>> chunks;
+    size_t count = 0;
+    size_t overflow = 0; // births since the table filled up
 
-    for (auto &nbr : neighbors)
+public:
+    static const uint32_t NO_PARENT = 0xffffffffu;
+    static const size_t MAX_IDS = NO_PARENT; // IDs run from 0 to NO_PARENT - 1
+
+    void clear()
+    {
+        chunks.clear();
+        count = 0;
+        overflow = 0;
+    }
+
+    /**
+     * Records a birth and returns the child's ID. Once the table is full
+     * it stops recording, says so once, and hands out IDs from 0 again:
+     * they still key the random draws, but no longer name one organism.
+     */
+    uint32_t add(uint32_t parent)
     {
-        int nx = nbr.first;
-        int ny = nbr.second;
-        if (!w.getCell(nx, ny))
+        if (count == MAX_IDS)
         {
-            w.setCell(nx, ny, this);
-            w.setCell(getX(), getY(), nullptr);
-            setPos(nx, ny);
-            break;
+            if (overflow == 0)
+                cerr << "Lineage table full after " << MAX_IDS << " births; lineage is no longer recorded\n";
+            return static_cast<uint32_t>(overflow++ % MAX_IDS);
         }
+        if (count % CHUNK == 0)
+            chunks.push_back(make_shared<Chunk>());
+        else if (chunks.back().use_count() > 1)
+            chunks.back() = make_shared<Chunk>(*chunks.back());
+        (*chunks.back())[count % CHUNK] = parent;
+        return static_cast<uint32_t>(count++);
     }
 
-    // (2) Breed
-    incBreed();
-    if (getBreedCount() >= ANT_BREED)
+    size_t size() const { return count; }
+
+    /**
+     * True once IDs ran out; the queries below are then empty
+     */
+    bool full() const { return count == MAX_IDS; }
+
+    /**
+     * Bytes a copy of the table does not share with the original
+     */
+    size_t unsharedBytes() const { return chunks.size() * sizeof(shared_ptr<Chunk>) + sizeof(Chunk); }
+
+    uint32_t parentOf(uint32_t id) const { return (*chunks[id / CHUNK])[id % CHUNK]; }
+
+    /**
+     * Founder (parentless ancestor) of every ID
+     */
+    vector<uint32_t> founders() const
     {
-        shuffle(neighbors.begin(), neighbors.end(), gen);
-        for (auto &nbr : neighbors)
+        if (full())
+            return {};
+        vector<uint32_t> f(count);
+        for (size_t i = 0; i < count; i++)
         {
-            int nx = nbr.first;
-            int ny = nbr.second;
-            if (!w.getCell(nx, ny))
-            {
-                w.createAnt(nx, ny);
-                break;
-            }
+            uint32_t parent = parentOf(static_cast<uint32_t>(i));
+            f[i] = (parent == NO_PARENT) ? static_cast<uint32_t>(i) : f[parent];
         }
-        resetBreed();
+        return f;
     }
+
+    /**
+     * (founder, descendants ever born) for every founder, largest first
+     */
+    vector<pair<uint32_t, uint32_t>> descendantCounts() const
+    {
+        vector<uint32_t> f = founders();
+        map<uint32_t, uint32_t> counts;
+        for (size_t i = 0; i < f.size(); i++)
+        {
+            if (f[i] == i)
+                counts[f[i]] += 0;
+            else
+                counts[f[i]]++;
+        }
+        vector<pair<uint32_t, uint32_t>> result(counts.begin(), counts.end());
+        stable_sort(result.begin(), result.end(), [](const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b)
+                    { return a.second > b.second; });
+        return result;
+    }
+};
+
+/**
+ * OrgSlots: slot map from OrgHandles to organisms. Lookups and
+ * removals are O(1); a removed slot bumps its generation, so stale
+ * handles resolve to nullptr instead of a dangling pointer. Slots freed
+ * during a step are held back until recycle() is called at the start of
+ * the next one, so a handle taken during a step is never reissued
+ * before the step ends and wrap-around of the generation is harmless.
+ * Holding them back needs at most two slots per cell, so worlds are
+ * limited to MAX_SLOTS / 2 cells. all() lists every handle in use.
+ * The slots own the live organisms: copies clone them and destruction
+ * deletes them (remove() hands one back to the caller).
+ */
+class OrgSlots
+{
+private:
+    static const int GEN_BITS = 5;
+    static const uint32_t GEN_MASK = (1u << GEN_BITS) - 1;
+
+    vector<Organism *> objects;
+    vector<uint8_t> gens;
+    vector<uint32_t> livePos; // index of each slot in `live`
+    deque<uint32_t> freeSlots;
+    vector<uint32_t> retired; // freed since the last recycle()
+    vector<OrgHandle> live;
+
+public:
+    static const uint32_t MAX_SLOTS = 1u << (32 - GEN_BITS);
+
+    OrgSlots() {}
+
+    OrgSlots(const OrgSlots &other)
+        : objects(other.objects), gens(other.gens), livePos(other.livePos),
+          freeSlots(other.freeSlots), retired(other.retired), live(other.live)
+    {
+        for (OrgHandle h : live)
+            objects[indexOf(h)] = objects[indexOf(h)]->clone();
+    }
+
+    OrgSlots(OrgSlots &&other) noexcept { swap(other); }
+
+    OrgSlots &operator=(OrgSlots other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~OrgSlots()
+    {
+        for (OrgHandle h : live)
+            delete objects[indexOf(h)];
+    }
+
+    void swap(OrgSlots &other) noexcept
+    {
+        objects.swap(other.objects);
+        gens.swap(other.gens);
+        livePos.swap(other.livePos);
+        freeSlots.swap(other.freeSlots);
+        retired.swap(other.retired);
+        live.swap(other.live);
+    }
+
+    static uint32_t indexOf(OrgHandle h) { return h >> GEN_BITS; }
+
+    /**
+     * Stores org and returns its handle (also written to the organism)
+     */
+    OrgHandle insert(Organism *org)
+    {
+        uint32_t idx;
+        if (!freeSlots.empty())
+        {
+            idx = freeSlots.front();
+            freeSlots.pop_front();
+        }
+        else
+        {
+            idx = static_cast<uint32_t>(objects.size());
+            if (idx >= MAX_SLOTS)
+            {
+                cerr << "Too many organisms for 32-bit handles\n";
+                abort();
+            }
+            objects.push_back(nullptr);
+            gens.push_back(1);
+            livePos.push_back(0);
+        }
+        OrgHandle h = (idx << GEN_BITS) | gens[idx];
+        objects[idx] = org;
+        livePos[idx] = static_cast<uint32_t>(live.size());
+        live.push_back(h);
+        org->setHandle(h);
+        return h;
+    }
+
+    Organism *get(OrgHandle h) const
+    {
+        uint32_t idx = indexOf(h);
+        if (idx >= objects.size() || gens[idx] != (h & GEN_MASK))
+            return nullptr;
+        return objects[idx];
+    }
+
+    bool valid(OrgHandle h) const { return get(h) != nullptr; }
+
+    /**
+     * Starts loading the slot of h into the cache
+     */
+    void prefetch(OrgHandle h) const
+    {
+        uint32_t idx = indexOf(h);
+        if (idx < objects.size())
+        {
+            __builtin_prefetch(&objects[idx]);
+            __builtin_prefetch(&gens[idx]);
+        }
+    }
+
+    /**
+     * Releases the slot and returns the organism (the caller deletes it)
+     */
+    Organism *remove(OrgHandle h)
+    {
+        Organism *org = get(h);
+        if (!org)
+            return nullptr;
+        uint32_t idx = indexOf(h);
+        // Swap-remove from the dense list
+        OrgHandle last = live.back();
+        live[livePos[idx]] = last;
+        livePos[indexOf(last)] = livePos[idx];
+        live.pop_back();
+
+        objects[idx] = nullptr;
+        gens[idx] = (gens[idx] == GEN_MASK) ? 1 : gens[idx] + 1;
+        retired.push_back(idx);
+        return org;
+    }
+
+    /**
+     * Makes the slots freed since the last call available again
+     */
+    void recycle()
+    {
+        freeSlots.insert(freeSlots.end(), retired.begin(), retired.end());
+        retired.clear();
+    }
+
+    const vector<OrgHandle> &all() const { return live; }
+
+    size_t count() const { return live.size(); }
+
+    /**
+     * Deletes every organism and forgets every slot
+     */
+    void clear()
+    {
+        for (OrgHandle h : live)
+            delete objects[indexOf(h)];
+        objects.clear();
+        gens.clear();
+        livePos.clear();
+        freeSlots.clear();
+        retired.clear();
+        live.clear();
+    }
+};
+
+/**
+ * Scans one row of a text map: 'o' ant, 'X' doodlebug, '-' or '.'
+ * empty, separated by optional spaces/tabs/CR (the operator<< format,
+ * or the same glyphs packed together). Calls onOrganism(col, glyph) for
+ * every occupied cell and sets cols to the number of cells in the row.
+ * With SSE2, 16 characters are classified per compare and chunks with
+ * no organisms are skipped by a popcount. Returns false on any other
+ * character.
+ */
+template <typename Fn>
+bool scanMapRow(const char *p, const char *end, int &cols, Fn onOrganism)
+{
+    cols = 0;
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+    const __m128i dash = _mm_set1_epi8('-'), dot = _mm_set1_epi8('.');
+    const __m128i ant = _mm_set1_epi8('o'), doodle = _mm_set1_epi8('X');
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned ws = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                                     _mm_cmpeq_epi8(v, cr)));
+        unsigned empty = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, dash), _mm_cmpeq_epi8(v, dot)));
+        unsigned ants = _mm_movemask_epi8(_mm_cmpeq_epi8(v, ant));
+        unsigned doodles = _mm_movemask_epi8(_mm_cmpeq_epi8(v, doodle));
+        unsigned tokens = empty | ants | doodles;
+        if ((tokens | ws) != 0xffff)
+            return false;
+        for (unsigned occ = ants | doodles; occ; occ &= occ - 1)
+        {
+            int bit = __builtin_ctz(occ);
+            onOrganism(cols + __builtin_popcount(tokens & ((1u << bit) - 1)), p[bit]);
+        }
+        cols += __builtin_popcount(tokens);
+    }
+#endif
+    for (; p < end; p++)
+    {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r')
+            continue;
+        if (c == 'o' || c == 'X')
+            onOrganism(cols, c);
+        else if (c != '-' && c != '.')
+            return false;
+        cols++;
+    }
+    return true;
+}
+
+/**
+ * Packed per-cell state kept alongside the grid for whole-grid scans
+ */
+enum CellKind : uint8_t
+{
+    KIND_EMPTY = 0,
+    KIND_ANT = 1,
+    KIND_DOODLE = 2
+};
+
+static inline uint8_t kindOf(const Organism *o)
+{
+    if (!o)
+        return KIND_EMPTY;
+    return (o->getCharacter() == 'X') ? KIND_DOODLE : KIND_ANT;
+}
+
+/**
+ * Census: whole-grid statistics. Pairs count cells that are neighbors
+ * in the compile-time NEIGHBORHOOD (diagonals too when it is 8), each
+ * pair once.
+ */
+struct Census
+{
+    long ants = 0, doodles = 0;
+    long antPairs = 0, doodlePairs = 0, mixedPairs = 0;
+    long cells = 0;
+
+    double occupancy() const { return cells ? double(ants + doodles) / cells : 0; }
+
+    // Mean number of same-species neighbors (in the neighborhood in force)
+    // per organism: a clustering measure
+    double antClustering() const { return ants ? 2.0 * antPairs / ants : 0; }
+    double doodleClustering() const { return doodles ? 2.0 * doodlePairs / doodles : 0; }
+
+    void add(const Census &o)
+    {
+        ants += o.ants;
+        doodles += o.doodles;
+        antPairs += o.antPairs;
+        doodlePairs += o.doodlePairs;
+        mixedPairs += o.mixedPairs;
+        cells += o.cells;
+    }
+};
+
+#ifdef __SSE2__
+/**
+ * Sums the 16 byte counters of acc (each at most 255)
+ */
+static inline long byteSum(__m128i acc)
+{
+    __m128i s = _mm_sad_epu8(acc, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+}
+#endif
+
+/**
+ * Adds the ants and doodlebugs among n packed cells. The SSE2 path
+ * keeps per-byte counters (compare masks are -1, so subtracting them
+ * counts) and folds them with a sum of absolute differences every 255
+ * blocks, before they can overflow.
+ */
+static void censusCount(const uint8_t *a, int n, Census &c)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i ant = _mm_set1_epi8(KIND_ANT), doodle = _mm_set1_epi8(KIND_DOODLE);
+    while (i + 16 <= n)
+    {
+        __m128i ants = _mm_setzero_si128(), doodles = _mm_setzero_si128();
+        for (int k = 0; k < 255 && i + 16 <= n; k++, i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            ants = _mm_sub_epi8(ants, _mm_cmpeq_epi8(v, ant));
+            doodles = _mm_sub_epi8(doodles, _mm_cmpeq_epi8(v, doodle));
+        }
+        c.ants += byteSum(ants);
+        c.doodles += byteSum(doodles);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        c.ants += (a[i] == KIND_ANT);
+        c.doodles += (a[i] == KIND_DOODLE);
+    }
+}
+
+/**
+ * Adds the same-species and ant/doodlebug pairs formed by a[i], b[i],
+ * counting the same way as censusCount
+ */
+static void censusPairs(const uint8_t *a, const uint8_t *b, int n, Census &c)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i ant = _mm_set1_epi8(KIND_ANT), doodle = _mm_set1_epi8(KIND_DOODLE);
+    while (i + 16 <= n)
+    {
+        __m128i aa = _mm_setzero_si128(), dd = _mm_setzero_si128(), ad = _mm_setzero_si128();
+        for (int k = 0; k < 255 && i + 16 <= n; k++, i += 16)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            __m128i a1 = _mm_cmpeq_epi8(va, ant), b1 = _mm_cmpeq_epi8(vb, ant);
+            __m128i a2 = _mm_cmpeq_epi8(va, doodle), b2 = _mm_cmpeq_epi8(vb, doodle);
+            aa = _mm_sub_epi8(aa, _mm_and_si128(a1, b1));
+            dd = _mm_sub_epi8(dd, _mm_and_si128(a2, b2));
+            ad = _mm_sub_epi8(ad, _mm_or_si128(_mm_and_si128(a1, b2), _mm_and_si128(a2, b1)));
+        }
+        c.antPairs += byteSum(aa);
+        c.doodlePairs += byteSum(dd);
+        c.mixedPairs += byteSum(ad);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        c.antPairs += (a[i] == KIND_ANT && b[i] == KIND_ANT);
+        c.doodlePairs += (a[i] == KIND_DOODLE && b[i] == KIND_DOODLE);
+        c.mixedPairs += (a[i] | b[i]) == (KIND_ANT | KIND_DOODLE);
+    }
+}
+
+/**
+ * ORs freeBit into to[i] where from[i] is empty and antBit where it
+ * holds an ant, 16 cells per SSE2 compare
+ */
+static void maskRow(NeighborMask *to, const uint8_t *from, int n, NeighborMask freeBit, NeighborMask antBit)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i empty = _mm_set1_epi8(KIND_EMPTY), ant = _mm_set1_epi8(KIND_ANT);
+#if NEIGHBORHOOD == 8
+    const __m128i freeBits = _mm_set1_epi16(freeBit), antBits = _mm_set1_epi16(antBit);
+#else
+    const __m128i freeBits = _mm_set1_epi8(freeBit), antBits = _mm_set1_epi8(antBit);
+#endif
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from + i));
+        __m128i isEmpty = _mm_cmpeq_epi8(k, empty), isAnt = _mm_cmpeq_epi8(k, ant);
+        __m128i *out = reinterpret_cast<__m128i *>(to + i);
+#if NEIGHBORHOOD == 8
+        // Widen the byte compares to the 16-bit mask lanes
+        __m128i lo = _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi8(isEmpty, isEmpty), freeBits),
+                                  _mm_and_si128(_mm_unpacklo_epi8(isAnt, isAnt), antBits));
+        __m128i hi = _mm_or_si128(_mm_and_si128(_mm_unpackhi_epi8(isEmpty, isEmpty), freeBits),
+                                  _mm_and_si128(_mm_unpackhi_epi8(isAnt, isAnt), antBits));
+        _mm_storeu_si128(out, _mm_or_si128(_mm_loadu_si128(out), lo));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_loadu_si128(out + 1), hi));
+#else
+        __m128i bits = _mm_or_si128(_mm_and_si128(isEmpty, freeBits), _mm_and_si128(isAnt, antBits));
+        _mm_storeu_si128(out, _mm_or_si128(_mm_loadu_si128(out), bits));
+#endif
+    }
+#endif
+    for (; i < n; i++)
+        to[i] |= (from[i] == KIND_EMPTY ? freeBit : 0) | (from[i] == KIND_ANT ? antBit : 0);
+}
+
+/**
+ * ClusterStats: connected clusters (same species, connected through the
+ * neighborhood in force) of each species; sizeBins[k] counts clusters of 2^k to 2^(k+1) - 1 cells
+ */
+struct ClusterStats
+{
+    struct Species
+    {
+        long clusters = 0;
+        long largest = 0;
+        long cells = 0;
+        vector<long> sizeBins;
+
+        double meanSize() const { return clusters ? static_cast<double>(cells) / clusters : 0; }
+    } ants, doodles;
+};
+
+/**
+ * Labels the clusters of a packed kinds plane with union-find over
+ * horizontal runs of one species, which are far fewer than cells.
+ * Bands of rows find their runs and join them to touching runs in the
+ * row above (overlapping, or also diagonally adjacent under
+ * NEIGHBORHOOD 8) in parallel, each in its own index range; the rows
+ * where bands meet are joined afterwards, then every run is added to
+ * its root's total.
+ */
+class ClusterLabeler
+{
+private:
+    struct Run
+    {
+        int begin, end; // columns [begin, end)
+        uint8_t kind;
+    };
+
+    const uint8_t *kinds = nullptr;
+    int size = 0;
+    vector<vector<Run>> bandRuns;
+    vector<vector<uint32_t>> bandRowStart; // per band, index of each row's first run (+ end)
+    vector<uint32_t> bandOffset;           // global index of each band's first run
+    vector<uint32_t> parent;
+    vector<uint32_t> cells;     // per root
+    vector<uint8_t> kindOfRoot; // per root
+
+    uint32_t find(uint32_t i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void unite(uint32_t a, uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a != b)
+            parent[max(a, b)] = min(a, b);
+    }
+
+    void findRuns(int band, int begin, int end)
+    {
+        vector<Run> &runs = bandRuns[band];
+        vector<uint32_t> &rowStart = bandRowStart[band];
+        size_t n = 0;
+        for (int x = begin; x < end; x++)
+        {
+            rowStart.push_back(static_cast<uint32_t>(n));
+            if (runs.size() < n + size + 1)
+                runs.resize(max(2 * runs.size(), n + size + 1));
+            const uint8_t *row = kinds + static_cast<size_t>(x) * size;
+            Run *r = runs.data();
+
+            // r[n] is the open run; it is kept (n advances) at the next
+            // change of kind unless it is empty cells
+            r[n] = {0, 0, row[0]};
+            auto boundary = [&](int y)
+            {
+                r[n].end = y;
+                n += r[n].kind != KIND_EMPTY;
+                r[n] = {y, 0, row[y]};
+            };
+            int y = 1;
+#ifdef __SSE2__
+            for (; y + 16 <= size; y += 16)
+            {
+                __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + y)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + y - 1)));
+                unsigned changes = ~_mm_movemask_epi8(same) & 0xFFFF;
+                for (; changes; changes &= changes - 1)
+                    boundary(y + __builtin_ctz(changes));
+            }
+#endif
+            for (; y < size; y++)
+                if (row[y] != row[y - 1])
+                    boundary(y);
+            r[n].end = size;
+            n += r[n].kind != KIND_EMPTY;
+        }
+        rowStart.push_back(static_cast<uint32_t>(n));
+        runs.resize(n);
+    }
+
+    /**
+     * Joins runs a[i] (global index aBase + i) with the runs of b that
+     * touch them and hold the same species
+     */
+    void joinRows(const Run *a, uint32_t aCount, uint32_t aBase, const Run *b, uint32_t bCount, uint32_t bBase)
+    {
+#if NEIGHBORHOOD == 8
+        // Runs also touch diagonally, so one of b's runs may meet both
+        // a[i] and a[i + 1] at a shared end; a two-pointer merge would
+        // step past such pairs, so each run scans its reach instead
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < aCount; i++)
+        {
+            while (j < bCount && b[j].end < a[i].begin)
+                j++;
+            for (uint32_t k = j; k < bCount && b[k].begin <= a[i].end; k++)
+                if (a[i].kind == b[k].kind)
+                    unite(aBase + i, bBase + k);
+        }
+#else
+        uint32_t i = 0, j = 0;
+        while (i < aCount && j < bCount)
+        {
+            if (a[i].kind == b[j].kind && a[i].begin < b[j].end && b[j].begin < a[i].end)
+                unite(aBase + i, bBase + j);
+            bool stepA = a[i].end < b[j].end;
+            i += stepA;
+            j += !stepA;
+        }
+#endif
+    }
+
+    /**
+     * Joins row r of band (local row index) with the row below it
+     */
+    void joinBelow(int band, int r, int belowBand, int belowRow)
+    {
+        const vector<uint32_t> &ra = bandRowStart[band], &rb = bandRowStart[belowBand];
+        uint32_t a0 = ra[r], a1 = ra[r + 1], b0 = rb[belowRow], b1 = rb[belowRow + 1];
+        joinRows(bandRuns[band].data() + a0, a1 - a0, bandOffset[band] + a0,
+                 bandRuns[belowBand].data() + b0, b1 - b0, bandOffset[belowBand] + b0);
+    }
+
+public:
+    ClusterLabeler() {}
+
+    // Copies (of a World) start without buffers
+    ClusterLabeler(const ClusterLabeler &) {}
+    ClusterLabeler &operator=(const ClusterLabeler &) { return *this; }
+
+    /**
+     * Labels a size x size plane; the buffers are kept for the next call
+     */
+    ClusterStats label(const uint8_t *plane, int planeSize, int threads)
+    {
+        kinds = plane;
+        size = planeSize;
+        int bands = max(1, min(threads, size / 64));
+        int per = (size + bands - 1) / bands;
+        bands = (size + per - 1) / per; // as parallelBands splits them
+        bandRuns.resize(bands);
+        bandRowStart.resize(bands);
+        for (int b = 0; b < bands; b++)
+            bandRowStart[b].clear();
+        parallelBands(size, bands, [&](int b, int begin, int end)
+                      { findRuns(b, begin, end); });
+
+        bandOffset.assign(bands, 0);
+        uint32_t total = 0;
+        for (int b = 0; b < bands; b++)
+        {
+            bandOffset[b] = total;
+            total += static_cast<uint32_t>(bandRuns[b].size());
+        }
+        parent.resize(total);
+        for (uint32_t i = 0; i < total; i++)
+            parent[i] = i;
+
+        // Unions inside a band only touch that band's index range
+        parallelBands(size, bands, [&](int b, int begin, int end)
+                      {
+            for (int r = 0; r + 1 < end - begin; r++)
+                joinBelow(b, r, b, r + 1); });
+        for (int b = 0; b + 1 < bands; b++)
+            joinBelow(b, static_cast<int>(bandRowStart[b].size()) - 2, b + 1, 0);
+
+        // Unions always link to the smaller root, so every parent index is
+        // below its child's and one forward pass flattens all runs onto
+        // their roots
+        for (uint32_t i = 0; i < total; i++)
+            parent[i] = parent[parent[i]];
+        cells.assign(total, 0);
+        kindOfRoot.resize(total);
+        for (int b = 0; b < bands; b++)
+        {
+            const Run *runs = bandRuns[b].data();
+            const uint32_t *roots = parent.data() + bandOffset[b];
+            for (size_t i = 0; i < bandRuns[b].size(); i++)
+            {
+                cells[roots[i]] += runs[i].end - runs[i].begin;
+                kindOfRoot[roots[i]] = runs[i].kind;
+            }
+        }
+
+        ClusterStats stats;
+        for (uint32_t i = 0; i < total; i++)
+        {
+            if (parent[i] != i)
+                continue;
+            ClusterStats::Species &sp = (kindOfRoot[i] == KIND_ANT) ? stats.ants : stats.doodles;
+            long n = cells[i];
+            sp.clusters++;
+            sp.cells += n;
+            sp.largest = max(sp.largest, n);
+            size_t bin = 0;
+            while ((2L << bin) <= n)
+                bin++;
+            if (sp.sizeBins.size() <= bin)
+                sp.sizeBins.resize(bin + 1, 0);
+            sp.sizeBins[bin]++;
+        }
+        return stats;
+    }
+};
+
+/**
+ * FFT: in-order mixed-radix Cooley-Tukey transform of one length.
+ * The length is split into prime factors (2s first); radix-2 stages
+ * use a plain butterfly and other factors a direct DFT over the factor,
+ * so prime lengths degrade to a direct O(n^2) DFT.
+ */
+class FFT
+{
+private:
+    int n = 0;
+    vector<int> factors;
+    vector<complex<double>> twiddle; // exp(-2 pi i k / n)
+
+    /**
+     * Transforms the len points in[0], in[stride], ... into out[0 .. len),
+     * using factors[f] onwards; len = n / (product of earlier factors)
+     */
+    void pass(const complex<double> *in, size_t stride, complex<double> *out, int len, size_t f) const
+    {
+        if (len == 1)
+        {
+            out[0] = in[0];
+            return;
+        }
+        int p = factors[f], m = len / p;
+        for (int q = 0; q < p; q++)
+            pass(in + q * stride, stride * p, out + q * m, m, f + 1);
+
+        // out holds p interleaved sub-transforms of length m; combine them
+        size_t step = static_cast<size_t>(n / len); // twiddle index step for W_len
+        if (p == 2)
+        {
+            for (int k = 0; k < m; k++)
+            {
+                complex<double> t = out[k + m] * twiddle[k * step];
+                out[k + m] = out[k] - t;
+                out[k] += t;
+            }
+            return;
+        }
+        vector<complex<double>> terms(p);
+        for (int k = 0; k < m; k++)
+        {
+            for (int q = 0; q < p; q++)
+                terms[q] = out[k + q * m] * twiddle[(static_cast<size_t>(q) * k * step) % n];
+            for (int r = 0; r < p; r++)
+            {
+                complex<double> sum = 0;
+                for (int q = 0; q < p; q++)
+                    sum += terms[q] * twiddle[(static_cast<size_t>(q) * r % p) * (n / p)];
+                out[k + r * m] = sum;
+            }
+        }
+    }
+
+public:
+    void plan(int length)
+    {
+        n = length;
+        factors.clear();
+        for (int rest = n, d = 2; rest > 1;)
+        {
+            if (d * d > rest)
+                d = rest;
+            if (rest % d == 0)
+            {
+                factors.push_back(d);
+                rest /= d;
+            }
+            else
+                d += d == 2 ? 1 : 2;
+        }
+        twiddle.resize(n);
+        for (int k = 0; k < n; k++)
+            twiddle[k] = polar(1.0, -2 * M_PI * k / n);
+    }
+
+    int length() const { return n; }
+
+    /**
+     * out[k] = sum_j in[j * stride] exp(-2 pi i j k / n)
+     */
+    void transform(const complex<double> *in, size_t stride, complex<double> *out) const
+    {
+        pass(in, stride, out, n, 0);
+    }
+};
+
+/**
+ * SpectrumStats: radially averaged power spectra of the coarse-grained
+ * ant and doodlebug densities (mean removed). power[k] is the mean power
+ * of the wavevectors whose length rounds to k cycles per world; it
+ * corresponds to a wavelength of about worldSize / k cells. The peak is
+ * the single strongest wavevector, whose angle (degrees, 0 = along x,
+ * i.e. down the rows) gives the direction the wave fronts travel along.
+ */
+struct SpectrumStats
+{
+    struct Peak
+    {
+        int kx = 0, ky = 0;
+        double power = 0;
+        double wavelength = 0; // cells
+        double angle = 0;      // degrees in [0, 180)
+    };
+    int blocks = 0;    // coarse grid side
+    int blockSize = 0; // cells per block side
+    vector<double> antPower, doodlePower;
+    Peak antPeak, doodlePeak;
+};
+
+/**
+ * Computes SpectrumStats from a DensityPyramid level. Both species are
+ * transformed at once as the real and imaginary parts of one complex
+ * field; rows and then columns are transformed in parallel bands.
+ */
+class SpectrumAnalyzer
+{
+private:
+    FFT fft;
+    vector<complex<double>> field, rowsDone; // blocks x blocks
+
+public:
+    SpectrumAnalyzer() {}
+
+    // Like ClusterLabeler, copies start without buffers
+    SpectrumAnalyzer(const SpectrumAnalyzer &) {}
+    SpectrumAnalyzer &operator=(const SpectrumAnalyzer &) { return *this; }
+
+    /**
+     * Analyzes the blocks of pyramid level (>= 1) of a size x size world
+     */
+    SpectrumStats analyze(const DensityPyramid &density, int level, int size, int threads)
+    {
+        SpectrumStats stats;
+        int n = (size + (1 << level) - 1) >> level;
+        stats.blocks = n;
+        stats.blockSize = 1 << level;
+        if (fft.length() != n)
+            fft.plan(n);
+        field.resize(static_cast<size_t>(n) * n);
+        rowsDone.resize(field.size());
+
+        // Densities per cell, so the clipped blocks at the far edges count alike
+        auto extent = [&](int b)
+        { return min(size, (b + 1) << level) - (b << level); };
+        double antMean = static_cast<double>(density.totalAnts()) / (static_cast<double>(size) * size);
+        double doodleMean = static_cast<double>(density.totalDoodles()) / (static_cast<double>(size) * size);
+        for (int bx = 0; bx < n; bx++)
+            for (int by = 0; by < n; by++)
+            {
+                double cells = static_cast<double>(extent(bx)) * extent(by);
+                double a = density.ants(level, bx, by) / cells;
+                double d = density.doodles(level, bx, by) / cells;
+                field[static_cast<size_t>(bx) * n + by] = {a - antMean, d - doodleMean};
+            }
+
+        int bands = max(1, min(threads, n / 16));
+        parallelBands(n, bands, [&](int, int begin, int end)
+                      {
+            for (int x = begin; x < end; x++)
+                fft.transform(&field[static_cast<size_t>(x) * n], 1, &rowsDone[static_cast<size_t>(x) * n]); });
+        parallelBands(n, bands, [&](int, int begin, int end)
+                      {
+            vector<complex<double>> column(n);
+            for (int y = begin; y < end; y++)
+            {
+                fft.transform(&rowsDone[y], n, column.data());
+                for (int x = 0; x < n; x++)
+                    field[static_cast<size_t>(x) * n + y] = column[x];
+            } });
+
+        // Split Z = A + iB: A_k = (Z_k + conj Z_-k) / 2, B_k = (Z_k - conj Z_-k) / 2i
+        int half = n / 2;
+        stats.antPower.assign(half + 1, 0);
+        stats.doodlePower.assign(half + 1, 0);
+        vector<int> shellSize(half + 1, 0);
+        double scale = 1.0 / (static_cast<double>(n) * n * n * n); // Parseval: shells sum to the variance
+        for (int u = 0; u < n; u++)
+            for (int v = 0; v < n; v++)
+            {
+                complex<double> z = field[static_cast<size_t>(u) * n + v];
+                complex<double> zc = conj(field[static_cast<size_t>((n - u) % n) * n + (n - v) % n]);
+                double pa = norm(z + zc) * 0.25 * scale;
+                double pd = norm(z - zc) * 0.25 * scale;
+                int ku = u <= half ? u : u - n, kv = v <= half ? v : v - n;
+                double radius = sqrt(static_cast<double>(ku * ku + kv * kv));
+                int shell = static_cast<int>(lround(radius));
+                if (shell <= half)
+                {
+                    stats.antPower[shell] += pa;
+                    stats.doodlePower[shell] += pd;
+                    shellSize[shell]++;
+                }
+                // Each wavevector and its negative carry the same power;
+                // count the one with kx > 0 (or kx = 0, ky > 0)
+                if (ku < 0 || (ku == 0 && kv <= 0))
+                    continue;
+                SpectrumStats::Peak *peaks[] = {&stats.antPeak, &stats.doodlePeak};
+                double powers[] = {pa, pd};
+                for (int s = 0; s < 2; s++)
+                {
+                    if (powers[s] <= peaks[s]->power)
+                        continue;
+                    SpectrumStats::Peak &peak = *peaks[s];
+                    peak.kx = ku;
+                    peak.ky = kv;
+                    peak.power = powers[s];
+                    peak.wavelength = static_cast<double>(n) * stats.blockSize / radius;
+                    peak.angle = fmod(atan2(kv, ku) * 180 / M_PI + 180, 180);
+                }
+            }
+        for (int k = 0; k <= half; k++)
+        {
+            if (shellSize[k])
+            {
+                stats.antPower[k] /= shellSize[k];
+                stats.doodlePower[k] /= shellSize[k];
+            }
+        }
+        return stats;
+    }
+};
+
+/**
+ * ScentOptions: doodlebugs leave scent that spreads and fades every
+ * step, and ants prefer to move where it is faint
+ */
+struct ScentOptions
+{
+    float deposit = 1.0f;   // added under every doodlebug each step
+    float spread = 0.5f;    // share of a cell's scent that flows to its 4 neighbors
+    float decay = 0.1f;     // share lost each step
+    float avoidance = 4.0f; // ants weight a move by 1 / (1 + avoidance * scent)
+};
+
+/**
+ * ScentField: one float per cell, double-buffered. step() deposits and
+ * applies a 5-point diffusion stencil (edges reflect, so nothing leaks
+ * out) in row bands across threads, each band walked in column tiles
+ * so the three rows it reads stay in cache.
+ */
+class ScentField
+{
+private:
+    int size = 0;
+    vector<float> cur, next;
+
+    // Columns per tile: three rows of floats fit comfortably in L1
+    static const int TILE = 1024;
+
+    /**
+     * next = k0 * c + k1 * (up + down + left + right) + deposit under
+     * doodlebugs, for columns [y0, y1) of row x
+     */
+    void stepRow(int x, int y0, int y1, float k0, float k1, float deposit, const uint8_t *kinds)
+    {
+        const float *c = &cur[static_cast<size_t>(x) * size];
+        const float *up = (x > 0) ? c - size : c;
+        const float *down = (x < size - 1) ? c + size : c;
+        const uint8_t *k = kinds + static_cast<size_t>(x) * size;
+        float *out = &next[static_cast<size_t>(x) * size];
+        auto scalar = [&](int y)
+        {
+            float left = c[y > 0 ? y - 1 : y], right = c[y < size - 1 ? y + 1 : y];
+            out[y] = k0 * c[y] + k1 * ((up[y] + down[y]) + (left + right)) +
+                     (k[y] == KIND_DOODLE ? deposit : 0.0f);
+        };
+        int y = y0;
+        for (; y < y1 && y < 1; y++)
+            scalar(y);
+#ifdef __SSE2__
+        const __m128 vk0 = _mm_set1_ps(k0), vk1 = _mm_set1_ps(k1), vdep = _mm_set1_ps(deposit);
+        const __m128i doodle = _mm_set1_epi8(KIND_DOODLE);
+        for (; y + 4 <= y1 && y + 4 < size; y += 4)
+        {
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(up + y), _mm_loadu_ps(down + y)),
+                                    _mm_add_ps(_mm_loadu_ps(c + y - 1), _mm_loadu_ps(c + y + 1)));
+            int four;
+            memcpy(&four, k + y, 4);
+            __m128i isDoodle = _mm_cmpeq_epi8(_mm_cvtsi32_si128(four), doodle);
+            isDoodle = _mm_unpacklo_epi8(isDoodle, isDoodle);
+            isDoodle = _mm_unpacklo_epi16(isDoodle, isDoodle);
+            __m128 v = _mm_add_ps(_mm_mul_ps(vk0, _mm_loadu_ps(c + y)), _mm_mul_ps(vk1, sum));
+            _mm_storeu_ps(out + y, _mm_add_ps(v, _mm_and_ps(_mm_castsi128_ps(isDoodle), vdep)));
+        }
+#endif
+        for (; y < y1; y++)
+            scalar(y);
+    }
+
+public:
+    void reset(int newSize)
+    {
+        size = newSize;
+        cur.assign(static_cast<size_t>(size) * size, 0.0f);
+        next.assign(cur.size(), 0.0f);
+    }
+
+    bool empty() const { return cur.empty(); }
+
+    float at(int cell) const { return cur[cell]; }
+
+    vector<float> &values() { return cur; }
+    const vector<float> &values() const { return cur; }
+
+    /**
+     * One step of deposit (under every KIND_DOODLE cell of kinds),
+     * spreading and decay
+     */
+    void step(const ScentOptions &opts, const uint8_t *kinds, int threads)
+    {
+        float keep = 1.0f - opts.decay;
+        float k0 = keep * (1.0f - opts.spread), k1 = keep * opts.spread / 4;
+        int bands = max(1, min(threads, size / 64));
+        parallelBands(size, bands, [&](int, int begin, int end)
+                      {
+            for (int y0 = 0; y0 < size; y0 += TILE)
+                for (int x = begin; x < end; x++)
+                    stepRow(x, y0, min(size, y0 + TILE), k0, k1, opts.deposit, kinds); });
+        cur.swap(next);
+    }
+};
+
+/**
+ * FoodOptions: a per-cell food supply that regrows every step. Ants eat
+ * from the cells they move onto and need the energy to breed.
+ */
+struct FoodOptions
+{
+    uint8_t capacity = 100; // most food a cell holds
+    uint8_t regrow = 1;     // food each cell gains per step, up to capacity
+    uint8_t meal = 20;      // most an ant eats from the cell it moves onto
+    uint8_t birthCost = 60; // energy an ant spends on each offspring
+};
+
+/**
+ * FoodField: one byte of food per cell. Regrowth saturates 16 cells per
+ * SSE2 op, runs chunks on several threads and skips chunks known to be
+ * full; eating from a cell marks its chunk as growing again.
+ */
+class FoodField
+{
+private:
+    static const int CHUNK = 4096; // cells per regrowth chunk
+    vector<uint8_t> food;
+    vector<uint8_t> full; // per chunk: every cell at capacity
+
+    /**
+     * Adds amount to n cells, saturating at cap; true if all are at cap
+     */
+    static bool regrowCells(uint8_t *f, int n, uint8_t amount, uint8_t cap)
+    {
+        int i = 0;
+        bool allFull = true;
+#ifdef __SSE2__
+        const __m128i add = _mm_set1_epi8(static_cast<char>(amount));
+        const __m128i top = _mm_set1_epi8(static_cast<char>(cap));
+        __m128i atTop = _mm_set1_epi8(-1);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(f + i);
+            __m128i v = _mm_min_epu8(_mm_adds_epu8(_mm_loadu_si128(p), add), top);
+            _mm_storeu_si128(p, v);
+            atTop = _mm_and_si128(atTop, _mm_cmpeq_epi8(v, top));
+        }
+        allFull = _mm_movemask_epi8(atTop) == 0xFFFF;
+#endif
+        for (; i < n; i++)
+        {
+            f[i] = static_cast<uint8_t>(min<int>(cap, f[i] + amount));
+            allFull = allFull && f[i] == cap;
+        }
+        return allFull;
+    }
+
+public:
+    void reset(size_t cells, uint8_t cap)
+    {
+        food.assign(cells, cap);
+        full.assign((cells + CHUNK - 1) / CHUNK, 1);
+    }
+
+    int at(int cell) const { return food[cell]; }
+
+    /**
+     * Takes up to `most` food from cell and returns how much was taken
+     */
+    int eat(int cell, int most)
+    {
+        int taken = min<int>(food[cell], most);
+        food[cell] = static_cast<uint8_t>(food[cell] - taken);
+        if (taken)
+            full[cell / CHUNK] = 0;
+        return taken;
+    }
+
+    const vector<uint8_t> &values() const { return food; }
+
+    /**
+     * Replaces every cell's food (e.g. from a checkpoint)
+     */
+    void load(const uint8_t *cells)
+    {
+        copy(cells, cells + food.size(), food.begin());
+        fill(full.begin(), full.end(), 0);
+    }
+
+    void regrow(uint8_t amount, uint8_t cap, int threads)
+    {
+        int chunks = static_cast<int>(full.size());
+        int bands = max(1, min(threads, chunks / 64));
+        parallelBands(chunks, bands, [&](int, int begin, int end)
+                      {
+            for (int c = begin; c < end; c++)
+            {
+                if (full[c])
+                    continue;
+                size_t first = static_cast<size_t>(c) * CHUNK;
+                int n = static_cast<int>(min<size_t>(CHUNK, food.size() - first));
+                full[c] = regrowCells(&food[first], n, amount, cap);
+            } });
+    }
+};
+
+/**
+ * PhaseTimings: wall-clock milliseconds spent in each part of the steps
+ * taken since the last resetTimings()
+ */
+struct PhaseTimings
+{
+    long steps = 0;
+    double engineMs = 0;   // update() / updateParallel() proper
+    double scentMs = 0;    // ScentField::step
+    double foodMs = 0;     // FoodField::regrow
+    double validateMs = 0; // per-step checks (setValidation)
+};
+
+static double msSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * TraitSummary: mean and variance of the traits of one species
+ */
+struct TraitSummary
+{
+    long count = 0;
+    double breedMean = 0, breedVariance = 0;
+    double starveMean = 0, starveVariance = 0; // doodlebugs only
+};
+
+/**
+ * TraitTable: each organism's heritable thresholds (the breedCount that
+ * triggers breeding, and for doodlebugs the starveCount that kills), as
+ * parallel arrays indexed by organism slot. The engines load a threshold
+ * where they used to compare against a constant, so the branches stay
+ * as predictable as the population is uniform. Per-species sums are
+ * updated at every birth and death, which makes the statistics O(1).
+ */
+class TraitTable
+{
+private:
+    vector<uint8_t> breedAt;
+    vector<uint8_t> starveAt;
+
+    struct Sums
+    {
+        long count = 0;
+        long breed = 0, breedSquares = 0;
+        long starve = 0, starveSquares = 0;
+    } sums[2]; // ants, doodlebugs
+
+public:
+    int breed(uint32_t slot) const { return breedAt[slot]; }
+    int starve(uint32_t slot) const { return starveAt[slot]; }
+
+    void set(uint32_t slot, bool doodle, int breed, int starve)
+    {
+        if (slot >= breedAt.size())
+        {
+            breedAt.resize(slot + 1, 0);
+            starveAt.resize(slot + 1, 0);
+        }
+        breedAt[slot] = static_cast<uint8_t>(breed);
+        starveAt[slot] = static_cast<uint8_t>(starve);
+        Sums &s = sums[doodle];
+        s.count++;
+        s.breed += breed;
+        s.breedSquares += breed * breed;
+        s.starve += starve;
+        s.starveSquares += starve * starve;
+    }
+
+    void drop(uint32_t slot, bool doodle)
+    {
+        int b = breedAt[slot], st = starveAt[slot];
+        Sums &s = sums[doodle];
+        s.count--;
+        s.breed -= b;
+        s.breedSquares -= b * b;
+        s.starve -= st;
+        s.starveSquares -= st * st;
+    }
+
+    TraitSummary summary(bool doodle) const
+    {
+        const Sums &s = sums[doodle];
+        TraitSummary t;
+        t.count = s.count;
+        if (s.count == 0)
+            return t;
+        double n = static_cast<double>(s.count);
+        t.breedMean = s.breed / n;
+        t.breedVariance = s.breedSquares / n - t.breedMean * t.breedMean;
+        if (doodle)
+        {
+            t.starveMean = s.starve / n;
+            t.starveVariance = s.starveSquares / n - t.starveMean * t.starveMean;
+        }
+        return t;
+    }
+
+    void clear()
+    {
+        breedAt.clear();
+        starveAt.clear();
+        sums[0] = sums[1] = Sums();
+    }
+};
+
+/**
+ * A trait value after mutation: with probability rate each (decided by
+ * the low 32 bits), one step up or down (bit 32), kept within 1..255
+ */
+static int mutateTrait(int value, uint64_t bits, double rate)
+{
+    if ((bits & 0xffffffffu) >= rate * 4294967296.0)
+        return value;
+    value += ((bits >> 32) & 1) ? 1 : -1;
+    return max(1, min(255, value));
+}
+
+/**
+ * OscillationStats: the population cycle as seen by OscillationEstimator.
+ * Periods are in steps; amplitudes are sqrt(2 x variance) in organisms
+ * (a sine's amplitude); strength is the autocorrelation at the period.
+ */
+struct OscillationStats
+{
+    bool warm = false;            // a window of steps has been seen
+    double antPeriod = 0, doodlePeriod = 0; // 0: no cycle found
+    double antStrength = 0, doodleStrength = 0;
+    double antAmplitude = 0, doodleAmplitude = 0;
+    int lag = 0;                  // steps by which doodlebugs trail ants
+    double lagDegrees = 0;        // lag as a phase of the ant cycle
+    double periodSpread = 0;      // coefficient of variation of recent ant periods
+    bool stationary = false;      // recent periods and amplitudes are steady
+};
+
+/**
+ * Streams the per-step population counts and keeps exponentially
+ * weighted (over about window steps) auto- and cross-correlations for
+ * lags up to MAX_LAG, so memory is bounded. A species' period is the
+ * first autocorrelation peak after it has gone negative, refined by a
+ * parabola through the neighbouring lags; the phase lag is where the
+ * doodlebug-after-ant cross-correlation peaks within one ant period.
+ * The estimate is sampled every window / 8 steps; once the last HISTORY
+ * samples agree, the cycle counts as stationary.
+ */
+class OscillationEstimator
+{
+public:
+    static constexpr int MAX_LAG = 512;
+    static constexpr int HISTORY = 16;
+    static constexpr double MIN_STRENGTH = 0.2;      // weaker peaks are noise
+    static constexpr double STEADY_PERIOD = 0.05;    // largest period spread that is stationary
+    static constexpr double STEADY_AMPLITUDE = 0.10; // likewise for amplitude
+
+private:
+    /**
+     * Mean and coefficient of variation of the last HISTORY samples
+     */
+    class Recent
+    {
+    private:
+        double values[HISTORY];
+        int count = 0, next = 0;
+
+    public:
+        void add(double v)
+        {
+            values[next] = v;
+            next = (next + 1) % HISTORY;
+            count = min(count + 1, HISTORY);
+        }
+
+        bool full() const { return count == HISTORY; }
+
+        double mean() const
+        {
+            double sum = 0;
+            for (int i = 0; i < count; i++)
+                sum += values[i];
+            return count ? sum / count : 0;
+        }
+
+        double spread() const
+        {
+            double m = mean(), sum = 0;
+            for (int i = 0; i < count; i++)
+                sum += (values[i] - m) * (values[i] - m);
+            return count > 1 && m != 0 ? sqrt(sum / (count - 1)) / fabs(m) : 0;
+        }
+    };
+
+    struct Series
+    {
+        double mean = 0;
+        // The last MAX_LAG + 1 counts, stored twice so that past[at + L]
+        // is always the count L steps ago
+        double past[2 * (MAX_LAG + 1)] = {};
+        double acf[MAX_LAG + 1] = {}; // running autocovariance by lag
+
+        /**
+         * Returns the period (0 if none) and sets strength
+         */
+        double period(double &strength) const
+        {
+            strength = 0;
+            if (acf[0] <= 0)
+                return 0;
+            int L = 1;
+            while (L < MAX_LAG && acf[L] > 0)
+                L++;
+            for (; L < MAX_LAG; L++)
+            {
+                if (acf[L] <= 0 || acf[L] < acf[L - 1] || acf[L] < acf[L + 1])
+                    continue;
+                strength = acf[L] / acf[0];
+                if (strength < MIN_STRENGTH)
+                    return 0;
+                double curve = acf[L - 1] - 2 * acf[L] + acf[L + 1];
+                return curve < 0 ? L + 0.5 * (acf[L - 1] - acf[L + 1]) / curve : L;
+            }
+            return 0;
+        }
+    };
+
+    Series ants, doodles;
+    double cross[MAX_LAG + 1] = {}; // doodlebugs now against ants L steps ago
+    int at = 0;                     // newest entry in Series::past
+    long steps = 0;
+    int window = 1024;
+    Recent periods, amplitudes;
+
+    void push(Series &s, double x, double rate)
+    {
+        s.mean += rate * (x - s.mean);
+        s.past[at] = s.past[at + MAX_LAG + 1] = x;
+    }
+
+public:
+    /**
+     * Forgets everything; the running statistics follow about window steps
+     */
+    void reset(int newWindow)
+    {
+        *this = OscillationEstimator();
+        window = max(16, newWindow);
+    }
+
+    int getWindow() const { return window; }
+
+    void add(int antCount, int doodleCount)
+    {
+        double rate = 1.0 / min<long>(window, steps + 1);
+        at = at == 0 ? MAX_LAG : at - 1;
+        push(ants, antCount, rate);
+        push(doodles, doodleCount, rate);
+        steps++;
+
+        const double *a = ants.past + at, *d = doodles.past + at;
+        double da = a[0] - ants.mean, dd = d[0] - doodles.mean;
+        int lags = static_cast<int>(min<long>(MAX_LAG, steps - 1));
+        for (int L = 0; L <= lags; L++)
+        {
+            double pa = a[L] - ants.mean;
+            ants.acf[L] += rate * (da * pa - ants.acf[L]);
+            doodles.acf[L] += rate * ((d[L] - doodles.mean) * dd - doodles.acf[L]);
+            cross[L] += rate * (dd * pa - cross[L]);
+        }
+
+        if (steps >= window && steps % max(1, window / 8) == 0)
+        {
+            OscillationStats s = stats();
+            periods.add(s.antPeriod);
+            amplitudes.add(s.antAmplitude);
+        }
+    }
+
+    OscillationStats stats() const
+    {
+        OscillationStats s;
+        s.warm = steps >= window;
+        s.antPeriod = ants.period(s.antStrength);
+        s.doodlePeriod = doodles.period(s.doodleStrength);
+        s.antAmplitude = sqrt(2 * max(0.0, ants.acf[0]));
+        s.doodleAmplitude = sqrt(2 * max(0.0, doodles.acf[0]));
+        if (s.antPeriod > 0)
+        {
+            int span = min(MAX_LAG, static_cast<int>(ceil(s.antPeriod)));
+            for (int L = 1; L < span; L++)
+                if (cross[L] > cross[s.lag])
+                    s.lag = L;
+            s.lagDegrees = 360 * s.lag / s.antPeriod;
+        }
+        s.periodSpread = periods.spread();
+        s.stationary = s.warm && periods.full() && periods.mean() > 0 && s.periodSpread < STEADY_PERIOD &&
+                       amplitudes.spread() < STEADY_AMPLITUDE;
+        return s;
+    }
+};
+
+/**
+ * ValidationOptions: how much grid/organism consistency checking
+ * World::update() does after each step. Sampled checks cost O(samples);
+ * a full check every fullEvery steps costs O(cells). Zero disables each.
+ */
+struct ValidationOptions
+{
+    int sampleCells = 0;
+    int sampleOrgs = 0;
+    int fullEvery = 0;
+};
+
+/**
+ * RunOptions: what World::run does besides stepping. Sampling and the
+ * stop checks happen after every sampleEvery / checkEvery steps,
+ * counted from the start of the run.
+ */
+struct RunOptions
+{
+    int threads = 0;               // updateParallel(threads) if > 0, else update()
+    int sampleEvery = 0;           // 0: never call onSample
+    function<void(World &)> onSample;
+    int checkEvery = 1;
+    bool stopOnExtinction = false; // stop once either species has died out
+    bool stopWhenStationary = false; // stop once the population cycle is steady
+    function<bool(World &)> stopWhen;
+};
+
+/**
+ * World class
+ */
+class World
+{
+private:
+    int size, age;
+    OrgGrid grid;
+    OrgSlots orgs;
+    vector<uint8_t> kinds; // CellKind of every cell, row-major
+    // Direction masks of each cell's empty neighbors (low bits) and ant
+    // neighbors (ANT_SHIFT up), row-major; kept current by setKind
+    vector<NeighborMask> neighborMasks;
+    static const int ANT_SHIFT = NUM_DIRS;
+    static const unsigned FREE_BITS = (1u << NUM_DIRS) - 1;
+    DensityPyramid density;
+    EventLog *events = nullptr;
+    int logAfter = -1; // events up to this age are not logged (already were)
+    LineageTable lineage;
+    TraitTable traits;
+    bool evolving = false;   // mutate traits at birth
+    bool traitsSaved = false; // traits may differ from the constants
+    double mutationRate = 0;
+    // Stochastic breeding: instead of counting to its breed limit L, an
+    // organism breeds each turn with probability 1 / L. The gap to its
+    // next breeding step is drawn from the geometric distribution, so
+    // the random draws scale with births, not with turns.
+    bool stochasticBreeding = false;
+    vector<int> breedDue; // per slot: step of the next breeding turn
+    ValidationOptions validation;
+    bool scentOn = false;
+    ScentOptions scentOpts;
+    // Optional layers stored after the bands of a version 2 checkpoint
+    enum CheckpointLayer : uint32_t
+    {
+        LAYER_SCENT = 1,
+        LAYER_FOOD = 2,
+        LAYER_TRAITS = 4,
+        LAYER_BREEDING = 8
+    };
+    bool foodOn = false;
+    FoodOptions foodOpts;
+    FoodField food;
+    ScentField scent;
+    PhaseTimings timings;
+    OscillationEstimator oscillation; // fed the counts after every step
+    mt19937 gen; // drives placement, update order and every organism's choices
+    uint64_t baseSeed;
+    mt19937 checkGen;
+    long violations = 0;
+
+    /**
+     * Reports one failed invariant
+     */
+    void violation(const char *what, int x, int y)
+    {
+        violations++;
+        cerr << "Invariant violated at step " << age << ": " << what
+             << " (" << x << ", " << y << ")\n";
+    }
+
+    /**
+     * Checks that a listed organism is live, in bounds and in its cell
+     */
+    void checkOrganism(OrgHandle h)
+    {
+        Organism *o = orgs.get(h);
+        if (!o)
+        {
+            violation("stale handle in organism list", -1, -1);
+            return;
+        }
+        int x = o->getX(), y = o->getY();
+        if (o->getHandle() != h)
+            violation("organism handle mismatch", x, y);
+        if (!inBounds(x, y))
+            violation("organism out of bounds", x, y);
+        else if (grid[x][y] != h)
+            violation("organism not in its grid cell", x, y);
+        if (o->getId() >= lineage.size())
+            violation("organism ID beyond lineage table", x, y);
+        if (isParked(h) && (o->getCharacter() != 'o' || (inBounds(x, y) && freeNeighbors(x, y))))
+            violation("parked organism is not an idle ant", x, y);
+    }
+
+    /**
+     * Checks that an occupied cell holds a live organism that agrees on
+     * its position. Double occupancy shows up as a position mismatch.
+     */
+    void checkCell(int x, int y)
+    {
+        Organism *o = orgs.get(grid[x][y]);
+        if (kinds[x * size + y] != kindOf(o))
+            violation("packed cell kind out of date", x, y);
+        if (neighborMasks[x * size + y] != computeMasks(x, y))
+            violation("neighbor masks out of date", x, y);
+        if (grid[x][y] == NO_ORG)
+            return;
+        if (!o)
+            violation("grid cell holds a dead organism", x, y);
+        else if (o->getX() != x || o->getY() != y)
+            violation("grid cell and organism disagree on position", x, y);
+    }
+
+    /**
+     * Gives a newborn (already in the organism table) its ID, recording
+     * the organism at (px, py) as parent, and its traits: the parent's,
+     * possibly mutated, or the defaults for founders
+     */
+    void registerBirth(Organism *child, int px, int py)
+    {
+        Organism *parent = (px < 0) ? nullptr : getCell(px, py);
+        child->setId(lineage.add(parent ? parent->getId() : LineageTable::NO_PARENT));
+        bool doodle = child->getCharacter() == 'X';
+        reserveBreedDue(child->getHandle());
+        if (!parent)
+        {
+            setDefaultTraits(child);
+            if (stochasticBreeding)
+                scheduleBreeding(child, age);
+            return;
+        }
+        uint32_t from = OrgSlots::indexOf(parent->getHandle());
+        int breed = traits.breed(from), starve = traits.starve(from);
+        if (evolving)
+        {
+            // Keyed by the child's ID, so updateParallel mutates the same way at any thread count
+            uint64_t bits = counterRandom(baseSeed, age, PHASE_MUTATION, child->getId());
+            int mutated = mutateTrait(breed, bits, mutationRate);
+            traitsSaved = traitsSaved || mutated != breed;
+            breed = mutated;
+            if (doodle)
+            {
+                mutated = mutateTrait(starve, mix64(bits), mutationRate);
+                traitsSaved = traitsSaved || mutated != starve;
+                starve = mutated;
+            }
+        }
+        traits.set(OrgSlots::indexOf(child->getHandle()), doodle, breed, starve);
+        if (stochasticBreeding)
+            scheduleBreeding(child, age);
+    }
+
+    /**
+     * Number of steps until o next breeds, at least 1: geometric with
+     * success probability 1 / breedLimit(o), inverted from one
+     * counter-based uniform so updateParallel agrees at any thread count
+     */
+    int geometricSkip(const Organism *o, int step) const
+    {
+        double p = 1.0 / breedLimit(o);
+        if (p >= 1)
+            return 1;
+        uint64_t r = counterRandom(baseSeed, step, PHASE_BREED_SKIP, o->getId());
+        double u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0); // (0, 1]
+        return 1 + static_cast<int>(min(1e9, floor(log(u) / log1p(-p))));
+    }
+
+    /**
+     * Schedules o's next breeding turn after `step`. The slot must
+     * already be in breedDue (see reserveBreedDue), so threads may call
+     * this for different organisms at once.
+     */
+    void scheduleBreeding(const Organism *o, int step)
+    {
+        breedDue[OrgSlots::indexOf(o->getHandle())] = step + geometricSkip(o, step);
+    }
+
+    void reserveBreedDue(OrgHandle h)
+    {
+        if (OrgSlots::indexOf(h) >= breedDue.size())
+            breedDue.resize(OrgSlots::indexOf(h) + 1, 0);
+    }
+
+    void setDefaultTraits(const Organism *o)
+    {
+        bool doodle = o->getCharacter() == 'X';
+        traits.set(OrgSlots::indexOf(o->getHandle()), doodle,
+                   doodle ? DOODLE_BREED : ANT_BREED, doodle ? DOODLE_STARVE : 0);
+    }
+
+    /**
+     * Neighbor masks of (x, y) worked out from the packed cell kinds
+     */
+    NeighborMask computeMasks(int x, int y) const
+    {
+        unsigned m = 0;
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            int nx = x + DIRS[d][0], ny = y + DIRS[d][1];
+            if (!inBounds(nx, ny))
+                continue;
+            uint8_t k = kinds[nx * size + ny];
+            if (k == KIND_EMPTY)
+                m |= 1u << d;
+            else if (k == KIND_ANT)
+                m |= 1u << (d + ANT_SHIFT);
+        }
+        return static_cast<NeighborMask>(m);
+    }
+
+    /**
+     * Recomputes every cell's neighbor masks after the kinds plane is
+     * replaced wholesale. Each direction is one pass over whole rows,
+     * comparing row x + dx shifted by dy (see maskRow), so eight
+     * directions cost little more than four.
+     */
+    void resetMasks()
+    {
+        neighborMasks.assign(static_cast<size_t>(size) * size, 0);
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            int dx = DIRS[d][0], dy = DIRS[d][1];
+            NeighborMask freeBit = static_cast<NeighborMask>(1u << d);
+            NeighborMask antBit = static_cast<NeighborMask>(1u << (d + ANT_SHIFT));
+            int yBegin = max(0, -dy), yEnd = min(size, size - dy);
+            for (int x = max(0, -dx); x < min(size, size - dx); x++)
+                maskRow(&neighborMasks[static_cast<size_t>(x) * size + yBegin],
+                        &kinds[static_cast<size_t>(x + dx) * size + yBegin + dy],
+                        yEnd - yBegin, freeBit, antBit);
+        }
+    }
+
+    /**
+     * Changes the packed kind of (x, y) and fixes up the masks of its
+     * (at most NUM_DIRS) neighbors, which see the cell from direction d ^ 1
+     */
+    void setKind(int x, int y, uint8_t kind)
+    {
+        if (kinds[x * size + y] == kind)
+            return;
+        kinds[x * size + y] = kind;
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            int nx = x + DIRS[d][0], ny = y + DIRS[d][1];
+            if (!inBounds(nx, ny))
+                continue;
+            unsigned back = d ^ 1;
+            NeighborMask &m = neighborMasks[nx * size + ny];
+            m &= ~((1u << back) | (1u << (back + ANT_SHIFT)));
+            if (kind == KIND_EMPTY)
+                m |= 1u << back;
+            else if (kind == KIND_ANT)
+                m |= 1u << (back + ANT_SHIFT);
+        }
+    }
+
+    /**
+     * Called whenever the occupant of (x, y) changes
+     */
+    void track(int x, int y, const Organism *before, const Organism *after)
+    {
+        setKind(x, y, kindOf(after));
+        if (parking && !after)
+            wakeAround(x, y);
+        if (before)
+            density.add(x, y, before->getCharacter(), -1);
+        if (after)
+            density.add(x, y, after->getCharacter(), 1);
+    }
+
+    /**
+     * Glyph for a block of `cells` cells holding a ants and d doodlebugs.
+     * '-' empty, 'x'/'X' some/many doodlebugs, '.'/'o'/'O' ant density.
+     */
+    static char densityGlyph(int a, int d, int cells)
+    {
+        if (d > 0)
+            return (d * 4 >= cells) ? 'X' : 'x';
+        if (a == 0)
+            return '-';
+        if (a * 3 < cells)
+            return '.';
+        if (a * 3 < cells * 2)
+            return 'o';
+        return 'O';
+    }
+
+    /**
+     * Deletes every organism and resizes the (now empty) world
+     */
+    void clear(int newSize)
+    {
+        orgs.clear();
+        lineage.clear();
+        traits.clear();
+        traitsSaved = false;
+        breedDue.clear();
+        size = newSize;
+        age = 0;
+        grid.assign(size, vector<OrgHandle>(size, NO_ORG));
+        kinds.assign(static_cast<size_t>(size) * size, KIND_EMPTY);
+        resetMasks();
+        density.reset(size);
+        if (scentOn)
+            scent.reset(size);
+        if (foodOn)
+            food.reset(static_cast<size_t>(size) * size, foodOpts.capacity);
+        parking = false;
+        parkedAt.clear();
+        active.clear();
+        oscillation.reset(oscillation.getWindow());
+    }
+
+    /**
+     * Registers a bulk-loaded organism as a founder and puts it in the grid.
+     * Call rebuildDensity() once all organisms are placed.
+     */
+    void place(Organism *o)
+    {
+        o->setId(lineage.add(LineageTable::NO_PARENT));
+        grid[o->getX()][o->getY()] = orgs.insert(o);
+        setDefaultTraits(o);
+        reserveBreedDue(o->getHandle());
+        if (stochasticBreeding)
+            scheduleBreeding(o, age);
+        kinds[o->getX() * size + o->getY()] = kindOf(o);
+    }
+
+    /**
+     * Recomputes the density pyramid from the organism table, and the
+     * neighbor masks from the cell kinds, after bulk loads
+     */
+    void rebuildDensity()
+    {
+        resetMasks();
+        density.reset(size);
+        for (auto h : orgs.all())
+        {
+            Organism *o = orgs.get(h);
+            density.add(o->getX(), o->getY(), o->getCharacter(), 1);
+        }
+    }
+
+    /**
+     * Encodes rows [begin, end) as an ant bitplane, a doodlebug bitplane
+     * and the counter streams of their occupants in row-major order. The
+     * bitplanes come straight from the kinds plane; only occupied cells
+     * (skipped 16 empty cells per SSE2 compare) touch their organism.
+     */
+    void encodeBand(int begin, int end, vector<uint8_t> &out) const
+    {
+        const uint8_t *plane = &kinds[static_cast<size_t>(begin) * size];
+        size_t cells = static_cast<size_t>(end - begin) * size;
+        putKindPlane(out, plane, cells, KIND_ANT);
+        putKindPlane(out, plane, cells, KIND_DOODLE);
+
+        vector<uint32_t> breeds, starves;
+        vector<int> occupied; // columns of one row's occupants
+        for (int x = begin; x < end; x++)
+        {
+            const uint8_t *row = &kinds[static_cast<size_t>(x) * size];
+            const OrgHandle *handles = grid[x].data();
+            occupied.clear();
+            int y = 0;
+#ifdef __SSE2__
+            const __m128i empty = _mm_set1_epi8(KIND_EMPTY);
+            for (; y + 16 <= size; y += 16)
+            {
+                unsigned bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + y)), empty)) & 0xFFFF;
+                for (; bits; bits &= bits - 1)
+                    occupied.push_back(y + __builtin_ctz(bits));
+            }
+#endif
+            for (; y < size; y++)
+                if (row[y] != KIND_EMPTY)
+                    occupied.push_back(y);
+            // The organisms are scattered in memory: fetch their slots
+            // and objects a few cells ahead of reading them
+            size_t n = occupied.size();
+            for (size_t i = 0; i < n; i++)
+            {
+                if (i + 16 < n)
+                    orgs.prefetch(handles[occupied[i + 16]]);
+                if (i + 8 < n)
+                {
+                    OrgHandle ahead = handles[occupied[i + 8]];
+                    __builtin_prefetch(orgs.get(ahead));
+                    if (OrgSlots::indexOf(ahead) < parkedAt.size())
+                        __builtin_prefetch(&parkedAt[OrgSlots::indexOf(ahead)]);
+                }
+                const Organism *o = orgs.get(handles[occupied[i]]);
+                breeds.push_back(breedCountOf(o));
+                if (row[occupied[i]] == KIND_DOODLE)
+                    starves.push_back(static_cast<const Doodlebug *>(o)->getStarveCount());
+            }
+        }
+        putCounters(out, breeds);
+        putCounters(out, starves);
+    }
+
+    /**
+     * Inverse of encodeBand. The slot map is not thread-safe, so the
+     * caller registers the organisms and places them in the grid.
+     */
+    bool decodeBand(int begin, int end, const uint8_t *p, const uint8_t *stop,
+                    vector<Organism *> &made)
+    {
+        size_t cells = static_cast<size_t>(end - begin) * size;
+        vector<uint8_t> ants(cells), doodles(cells);
+        if (!getBitplane(p, stop, ants) || !getBitplane(p, stop, doodles))
+            return false;
+        size_t nAnts = count(ants.begin(), ants.end(), 1);
+        size_t nDoodles = count(doodles.begin(), doodles.end(), 1);
+        vector<uint32_t> breeds(nAnts + nDoodles), starves(nDoodles);
+        if (!getCounters(p, stop, breeds) || !getCounters(p, stop, starves))
+            return false;
+
+        size_t i = 0, b = 0, s = 0;
+        for (int x = begin; x < end; x++)
+        {
+            for (int y = 0; y < size; y++, i++)
+            {
+                if (ants[i] && doodles[i])
+                    return false;
+                Organism *o = nullptr;
+                if (ants[i])
+                {
+                    o = new Ant(x, y);
+                }
+                else if (doodles[i])
+                {
+                    Doodlebug *d = new Doodlebug(x, y);
+                    d->setStarveCount(starves[s++]);
+                    o = d;
+                }
+                if (!o)
+                    continue;
+                o->setBreedCount(breeds[b++]);
+                made.push_back(o);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Decodes a checkpoint into this world, which is not yet in use (see
+     * decodeCheckpoint). Returns false if the data is malformed.
+     */
+    bool decodeFresh(const vector<uint8_t> &in)
+    {
+        const uint8_t *p = in.data();
+        const uint8_t *end = p + in.size();
+        uint32_t version, newSize, newAge, bands;
+        if (in.size() < 4 || !equal(p, p + 4, "DBCK"))
+            return false;
+        p += 4;
+        if (!getU32(p, end, version) || version < 1 || version > 2 ||
+            !getU32(p, end, newSize) || newSize == 0 || newSize > MAX_SIZE ||
+            !getU32(p, end, newAge) || static_cast<int>(newAge) < 0 || !getU32(p, end, bands) ||
+            bands == 0 || bands > newSize)
+            return false;
+
+        vector<const uint8_t *> starts(bands), stops(bands);
+        const uint8_t *payload = p + 4 * static_cast<size_t>(bands);
+        if (payload > end)
+            return false;
+        for (uint32_t b = 0; b < bands; b++)
+        {
+            uint32_t len = 0;
+            if (!getU32(p, end, len) || len > static_cast<size_t>(end - payload))
+                return false;
+            starts[b] = payload;
+            stops[b] = payload + len;
+            payload += len;
+        }
+
+        // Layers follow the last band
+        uint32_t layers = 0;
+        const uint8_t *q = payload;
+        const uint8_t *scentData = nullptr, *foodData = nullptr;
+        size_t cells = static_cast<size_t>(newSize) * newSize;
+        ScentOptions scentIn;
+        FoodOptions foodIn;
+        if (version >= 2 && (!getU32(q, end, layers) || (layers & ~(LAYER_SCENT | LAYER_FOOD | LAYER_TRAITS | LAYER_BREEDING))))
+            return false;
+        if (layers & LAYER_SCENT)
+        {
+            if (!getFloat(q, end, scentIn.deposit) || !getFloat(q, end, scentIn.spread) ||
+                !getFloat(q, end, scentIn.decay) || !getFloat(q, end, scentIn.avoidance) ||
+                static_cast<size_t>(end - q) / 4 < cells)
+                return false;
+            scentData = q;
+            q += 4 * cells;
+        }
+        if (layers & LAYER_FOOD)
+        {
+            if (static_cast<size_t>(end - q) < 4 + cells)
+                return false;
+            foodIn = {q[0], q[1], q[2], q[3]};
+            foodData = q + 4;
+            q = foodData + cells; // ant energies
+        }
+        setScent(scentData != nullptr, scentIn);
+        setFood(foodData != nullptr, foodIn);
+        stochasticBreeding = (layers & LAYER_BREEDING) != 0;
+
+        clear(newSize);
+        age = newAge;
+        if (scentData)
+            for (float &v : scent.values())
+                getFloat(scentData, end, v);
+        if (foodData)
+            food.load(foodData);
+        vector<vector<Organism *>> made(bands);
+        vector<char> ok(bands, 0);
+        // Bands must be split exactly as they were when encoding (see
+        // parallelBands), but are shared out among this machine's threads
+        int per = (size + static_cast<int>(bands) - 1) / static_cast<int>(bands);
+        parallelBands(static_cast<int>(bands), defaultBands(), [&](int, int first, int last)
+                      {
+            for (int b = first; b < last; b++)
+                ok[b] = decodeBand(min(size, b * per), min(size, b * per + per), starts[b], stops[b], made[b]); });
+
+        // Loaded organisms start new lineages
+        for (auto &part : made)
+            for (auto o : part)
+                place(o);
+        if (foodData)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    uint32_t energy = 0;
+                    if (kinds[x * size + y] != KIND_ANT)
+                        continue;
+                    if (!getVarint(q, end, energy))
+                        ok[0] = 0;
+                    static_cast<Ant *>(getCell(x, y))->setEnergy(static_cast<int>(energy));
+                }
+            }
+        }
+        float rate = 0;
+        bool evolve = false;
+        if (layers & LAYER_TRAITS)
+        {
+            if (q < end)
+                evolve = *q++ != 0;
+            if (!getFloat(q, end, rate))
+                ok[0] = 0;
+            for (int x = 0; x < size && ok[0]; x++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    Organism *o = getCell(x, y);
+                    if (!o)
+                        continue;
+                    bool doodle = kinds[x * size + y] == KIND_DOODLE;
+                    if (end - q < (doodle ? 2 : 1) || q[0] == 0 || (doodle && q[1] == 0))
+                    {
+                        ok[0] = 0;
+                        break;
+                    }
+                    uint32_t slot = OrgSlots::indexOf(o->getHandle());
+                    traits.drop(slot, doodle);
+                    traits.set(slot, doodle, q[0], doodle ? q[1] : 0);
+                    q += doodle ? 2 : 1;
+                }
+            }
+            traitsSaved = true;
+        }
+        setEvolution(evolve, rate);
+        if (layers & LAYER_BREEDING)
+        {
+            for (int x = 0; x < size && ok[0]; x++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    Organism *o = getCell(x, y);
+                    uint32_t wait = 0;
+                    if (!o)
+                        continue;
+                    if (!getVarint(q, end, wait))
+                    {
+                        ok[0] = 0;
+                        break;
+                    }
+                    breedDue[OrgSlots::indexOf(o->getHandle())] = age + static_cast<int>(wait);
+                }
+            }
+        }
+        if (count(ok.begin(), ok.end(), 0))
+            return false;
+        rebuildDensity();
+        return true;
+    }
+
+    /*
+     * Idle parking for update(). An ant that ends its turn with no empty
+     * neighbor can neither move nor breed next turn, so it is parked:
+     * it gets no turns and its breed counter is advanced lazily from
+     * parkedAt. Any cell next to it becoming empty wakes it (track).
+     * Other engines call unpark() first.
+     */
+    bool parking = false;
+    vector<int> parkedAt;        // per slot: age when parked, -1 if not
+    vector<OrgHandle> active;    // who gets a turn next step (dead handles allowed)
+    vector<OrgHandle> turnOrder; // this step's turns while update() runs
+    int turnIndex = -1;          // turn being taken, -1 outside update()
+
+    bool isParked(OrgHandle h) const
+    {
+        uint32_t idx = OrgSlots::indexOf(h);
+        return idx < parkedAt.size() && parkedAt[idx] >= 0;
+    }
+
+    void park(OrgHandle h)
+    {
+        uint32_t idx = OrgSlots::indexOf(h);
+        if (idx >= parkedAt.size())
+            parkedAt.resize(idx + 1, -1);
+        parkedAt[idx] = age;
+    }
+
+    /**
+     * Makes a parked ant active again. During update(), its turn this
+     * step (if it has not already had one) is still to come with the
+     * probability a full shuffle would give, and lands at a uniformly
+     * random place among the remaining turns.
+     */
+    void wake(OrgHandle h)
+    {
+        uint32_t idx = OrgSlots::indexOf(h);
+        int since = parkedAt[idx];
+        parkedAt[idx] = -1;
+        int n = static_cast<int>(turnOrder.size());
+        bool ahead = turnIndex >= 0 && since < age &&
+                     uniform_int_distribution<int>(0, n)(gen) > turnIndex;
+        Organism *o = orgs.get(h);
+        int last = age - (ahead ? 1 : 0); // last idle turn
+        o->setBreedCount(idleBreedCount(o->getBreedCount(), last - since, traits.breed(idx)));
+        // Idle breeding turns came to nothing; the wait from here on is
+        // geometric again
+        if (stochasticBreeding && breedDue[idx] <= last)
+            scheduleBreeding(o, last);
+        if (ahead)
+        {
+            turnOrder.push_back(h);
+            swap(turnOrder.back(), turnOrder[uniform_int_distribution<int>(turnIndex + 1, n)(gen)]);
+        }
+        else
+            active.push_back(h);
+    }
+
+    /**
+     * Wakes parked ants next to a cell that just became empty
+     */
+    void wakeAround(int x, int y)
+    {
+        unsigned ants = antNeighbors(x, y);
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            if (!(ants & (1u << d)))
+                continue;
+            OrgHandle h = grid[x + DIRS[d][0]][y + DIRS[d][1]];
+            if (isParked(h))
+                wake(h);
+        }
+    }
+
+    /**
+     * Brings every parked counter up to date and stops parking
+     */
+    void unpark()
+    {
+        if (!parking)
+            return;
+        for (auto h : orgs.all())
+        {
+            if (!isParked(h))
+                continue;
+            Organism *o = orgs.get(h);
+            uint32_t idx = OrgSlots::indexOf(h);
+            o->setBreedCount(idleBreedCount(o->getBreedCount(), age - parkedAt[idx], traits.breed(idx)));
+            if (stochasticBreeding && breedDue[idx] <= age)
+                scheduleBreeding(o, age);
+        }
+        parkedAt.clear();
+        active.clear();
+        parking = false;
+    }
+
+    /**
+     * Direction from mask (nonempty) chosen with u in [0, 1), each
+     * weighted by 1 / (1 + avoidance * scent) of the cell it leads to
+     */
+    int scentedDirection(unsigned mask, int x, int y, double u) const
+    {
+        float weights[NUM_DIRS];
+        float total = 0;
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            weights[d] = 0;
+            if (mask & (1u << d))
+                weights[d] = 1.0f / (1.0f + scentOpts.avoidance * scent.at((x + DIRS[d][0]) * size + y + DIRS[d][1]));
+            total += weights[d];
+        }
+        float target = static_cast<float>(u) * total;
+        int last = -1;
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            if (!weights[d])
+                continue;
+            last = d;
+            if (target < weights[d])
+                return d;
+            target -= weights[d];
+        }
+        return last; // rounding left target at or just above the last weight
+    }
+
+    /*
+     * Parallel engine state. want[] holds each claimant cell's chosen
+     * direction and is -1 everywhere outside a claim round; breeder[]
+     * maps a cell to the organism that started the step there.
+     */
+    vector<int8_t> want;
+    vector<OrgHandle> breeder;
+    vector<int> origins; // cells set in breeder
+    vector<vector<OrgHandle>> batchAnts, batchDoodles; // reused every step
+    mutable ClusterLabeler clusterLabeler;             // buffers reused every sample
+    mutable SpectrumAnalyzer spectrumAnalyzer;         // likewise
+
+    // Organisms act in this many random batches per step, which keeps
+    // the dynamics close to update()'s fully shuffled order
+    static const int ORDER_BATCHES = 32;
+    // Lists shorter than this per thread are processed inline
+    int parallelGrain = 2048;
+    int batch = 0;
+
+    // Streams for counterRandom; each retry round adds ROUND_STRIDE
+    // and each batch adds BATCH_STRIDE
+    enum ClaimStream
+    {
+        PHASE_DOODLES = 0,
+        PHASE_ANTS = 2,
+        PHASE_ANT_BREED = 4,
+        PHASE_DOODLE_BREED = 6,
+        ROUND_STRIDE = 8,
+        PHASE_COIN = ROUND_STRIDE * NUM_DIRS,
+        BATCH_STRIDE = PHASE_COIN + 1,
+        PHASE_ORDER = -1,   // batch assignment, shared by all batches
+        PHASE_MUTATION = -2,  // trait mutation at birth, keyed by child ID
+        PHASE_BREED_SKIP = -3 // stochastic breeding gaps, keyed by organism ID
+    };
+
+    uint64_t draw(int stream, int cell) const
+    {
+        return counterRandom(baseSeed, age, stream + batch * BATCH_STRIDE, cell);
+    }
+
+    int bandsFor(size_t items, int threads) const
+    {
+        return max(1, min(threads, static_cast<int>(items / parallelGrain)));
+    }
+
+    /**
+     * Keeps the items for which keep(item) is true, in order. keep runs
+     * on several threads, one contiguous chunk each.
+     */
+    template <typename Keep>
+    vector<int> parallelFilter(const vector<int> &items, int threads, Keep keep)
+    {
+        int n = static_cast<int>(items.size());
+        int bands = bandsFor(items.size(), threads);
+        vector<vector<int>> parts(bands);
+        parallelBands(n, bands, [&](int b, int begin, int end)
+                      {
+            for (int i = begin; i < end; i++)
+                if (keep(items[i]))
+                    parts[b].push_back(items[i]); });
+        vector<int> all;
+        for (auto &part : parts)
+            all.insert(all.end(), part.begin(), part.end());
+        return all;
+    }
+
+    /**
+     * Cell index a claimant at `cell` is aiming at
+     */
+    int claimTarget(int cell) const
+    {
+        int x = cell / size, y = cell % size;
+        return (x + DIRS[want[cell]][0]) * size + y + DIRS[want[cell]][1];
+    }
+
+    /**
+     * Direction of one of c's neighbors, chosen from the direction mask
+     * options(c), uniformly or (scented) as pickAntMove does; -1 if the
+     * mask is empty
+     */
+    template <typename Options>
+    int chooseNeighbor(int c, int stream, Options options, bool scented) const
+    {
+        unsigned m = options(c);
+        int n = directionCount(m);
+        if (n == 0)
+            return -1;
+        uint64_t r = draw(stream, c);
+        if (scented)
+            return scentedDirection(m, c / size, c % size, (r >> 11) * (1.0 / 9007199254740992.0));
+        return nthDirection(m, static_cast<int>(r % n));
+    }
+
+    /**
+     * The claimant with the lowest (priority, cell) among t's neighbors
+     * aiming at t
+     */
+    int bestClaimant(int t, int stream) const
+    {
+        int x = t / size, y = t % size, best = -1;
+        uint64_t bestPrio = 0;
+        for (int d = 0; d < NUM_DIRS; d++)
+        {
+            int nx = x + DIRS[d][0], ny = y + DIRS[d][1];
+            if (!inBounds(nx, ny))
+                continue;
+            int n = nx * size + ny;
+            if (want[n] < 0 || claimTarget(n) != t)
+                continue;
+            uint64_t prio = draw(stream + 1, n);
+            if (best < 0 || prio < bestPrio || (prio == bestPrio && n < best))
+            {
+                best = n;
+                bestPrio = prio;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Up to NUM_DIRS claim rounds for the claimant cells in cands. Each
+     * round every claimant proposes a neighbor from options (see
+     * chooseNeighbor) and
+     * conflicts go to the lowest counter-based priority; all of that is
+     * a pure function of the current grid, so it runs in parallel. Losers
+     * retry next round among the cells still available, as they would in
+     * a sequential update. settle(cell, won) is then called serially, in
+     * cands order, exactly once per claimant: with won = true when its
+     * claim succeeded (claimTarget(cell) is still valid), or false when
+     * it ran out of options or rounds. With scented, proposals avoid
+     * doodlebug scent (see chooseNeighbor).
+     */
+    template <typename Options, typename Settle>
+    void claimRounds(int threads, int phase, vector<int> cands, Options options, Settle settle,
+                     bool scented = false)
+    {
+        vector<uint8_t> won;
+        for (int round = 0; round < NUM_DIRS && !cands.empty(); round++)
+        {
+            int stream = phase + round * ROUND_STRIDE;
+            int n = static_cast<int>(cands.size());
+            int bands = bandsFor(cands.size(), threads);
+            parallelBands(n, bands, [&](int, int begin, int end)
+                          {
+                for (int i = begin; i < end; i++)
+                    want[cands[i]] = static_cast<int8_t>(chooseNeighbor(cands[i], stream, options, scented)); });
+            won.assign(n, 0);
+            parallelBands(n, bands, [&](int, int begin, int end)
+                          {
+                for (int i = begin; i < end; i++)
+                {
+                    int c = cands[i];
+                    won[i] = want[c] >= 0 && bestClaimant(claimTarget(c), stream) == c;
+                } });
+
+            vector<int> retry;
+            for (int i = 0; i < n; i++)
+            {
+                int c = cands[i];
+                if (won[i])
+                    settle(c, true);
+                else if (want[c] < 0 || round == NUM_DIRS - 1)
+                    settle(c, false);
+                else
+                    retry.push_back(c);
+            }
+            for (int c : cands)
+                want[c] = -1;
+            cands.swap(retry);
+        }
+    }
+
+    /**
+     * Moves the organism at cell to its claimed target
+     */
+    void moveClaimant(int cell)
+    {
+        int t = claimTarget(cell);
+        Organism *o = getCell(cell / size, cell % size);
+        setCell(t / size, t % size, o);
+        setCell(o->getX(), o->getY(), nullptr);
+        o->setPos(t / size, t % size);
+    }
+
+    unsigned emptyOptions(int c) const { return neighborMasks[c] & FREE_BITS; }
+
+    /**
+     * Adjacent ants if there are any, otherwise empty neighbors
+     */
+    unsigned preyOptions(int c) const
+    {
+        unsigned ants = neighborMasks[c] >> ANT_SHIFT;
+        return ants ? ants : emptyOptions(c);
+    }
+
+    /**
+     * Current cells of the still-living organisms in handles, in order
+     */
+    vector<int> cellsOf(const vector<OrgHandle> &handles) const
+    {
+        vector<int> cells;
+        cells.reserve(handles.size());
+        for (auto h : handles)
+            if (Organism *o = orgs.get(h))
+                cells.push_back(o->getX() * size + o->getY());
+        return cells;
+    }
+
+    /**
+     * Notes that the organism at cell c (about to move, or staying)
+     * started its turn at c
+     */
+    void markOrigin(int c)
+    {
+        origins.push_back(c);
+        breeder[c] = grid[c / size][c % size];
+    }
+
+    /**
+     * Parallel breeding: every organism listed by markOrigin ages, and
+     * those due claim an empty cell next to where they started their
+     * turn, exactly as update() breeds from its pre-move neighbor list
+     */
+    void parallelBreed(int threads, int phase)
+    {
+        vector<int> due = parallelFilter(origins, threads, [this](int c)
+                                         {
+            Organism *o = orgs.get(breeder[c]);
+            if (!o)
+                return false;
+            o->incBreed();
+            if (!readyToBreed(o))
+                return false;
+            if (o->getCharacter() == 'o' && !canAffordBirth(*static_cast<Ant *>(o)))
+            {
+                o->resetBreed();
+                return false;
+            }
+            return true; });
+        claimRounds(threads, phase, due, [this](int c)
+                    { return emptyOptions(c); }, [this](int c, bool won)
+                    {
+            Organism *o = orgs.get(breeder[c]);
+            if (won)
+            {
+                int t = claimTarget(c);
+                if (o->getCharacter() == 'X')
+                    createDoodlebug(t / size, t % size, o->getX(), o->getY());
+                else
+                {
+                    createAnt(t / size, t % size, o->getX(), o->getY());
+                    payForBirth(*static_cast<Ant *>(o));
+                }
+            }
+            o->resetBreed(); });
+        for (int c : origins)
+            breeder[c] = NO_ORG;
+        origins.clear();
+    }
+
+    /**
+     * Parallel phase for a batch of ants: claim an empty cell, then breed
+     */
+    void parallelAnts(int threads, const vector<OrgHandle> &ants)
+    {
+        claimRounds(threads, PHASE_ANTS, cellsOf(ants), [this](int c)
+                    { return emptyOptions(c); }, [this](int c, bool won)
+                    {
+            markOrigin(c);
+            if (won)
+            {
+                Ant *a = static_cast<Ant *>(getCell(c / size, c % size));
+                moveClaimant(c);
+                graze(*a);
+            } },
+                    scentOn);
+        parallelBreed(threads, PHASE_ANT_BREED);
+    }
+
+    /**
+     * Parallel phase for a batch of doodlebugs: starve, claim an adjacent
+     * ant or failing that an empty cell, then breed
+     */
+    void parallelDoodlebugs(int threads, const vector<OrgHandle> &doodles)
+    {
+        vector<int> alive;
+        for (int c : cellsOf(doodles))
+        {
+            Doodlebug *d = static_cast<Doodlebug *>(getCell(c / size, c % size));
+            if (d->getStarveCount() >= starveLimit(d))
+                deleteCell(c / size, c % size);
+            else
+                alive.push_back(c);
+        }
+
+        claimRounds(threads, PHASE_DOODLES, alive, [this](int c)
+                    { return preyOptions(c); }, [this](int c, bool won)
+                    {
+            Doodlebug *d = static_cast<Doodlebug *>(getCell(c / size, c % size));
+            markOrigin(c);
+            int t = won ? claimTarget(c) : -1;
+            if (t >= 0 && getCell(t / size, t % size))
+            {
+                logEvent(EVENT_PREDATION, t / size, t % size, c / size, c % size);
+                deleteCell(t / size, t % size);
+                moveClaimant(c);
+                d->setStarveCount(0);
+                return;
+            }
+            if (won)
+                moveClaimant(c);
+            d->setStarveCount(d->getStarveCount() + 1); });
+        parallelBreed(threads, PHASE_DOODLE_BREED);
+    }
+
+    /**
+     * Runs the per-step consistency checks requested by setValidation
+     */
+    void afterStep()
+    {
+        timings.steps++;
+        oscillation.add(antCount(), doodleCount());
+        if (scentOn)
+        {
+            auto started = chrono::steady_clock::now();
+            scent.step(scentOpts, kinds.data(), defaultBands());
+            timings.scentMs += msSince(started);
+        }
+        if (foodOn)
+        {
+            auto started = chrono::steady_clock::now();
+            food.regrow(foodOpts.regrow, foodOpts.capacity, defaultBands());
+            timings.foodMs += msSince(started);
+        }
+        auto started = chrono::steady_clock::now();
+        if (validation.fullEvery > 0 && age % validation.fullEvery == 0)
+            validate(true);
+        else if (validation.sampleCells > 0 || validation.sampleOrgs > 0)
+            validate(false);
+        timings.validateMs += msSince(started);
+    }
+
+public:
+    /**
+     * Largest side length: at most one organism per cell, plus the slots
+     * held back until the next step, must fit OrgSlots::MAX_SLOTS
+     */
+    static const int MAX_SIZE = 8192;
+
+    World(int size)
+        : size(size), age(0),
+          grid(size, vector<OrgHandle>(size, NO_ORG)),
+          kinds(static_cast<size_t>(size) * size, KIND_EMPTY)
+    {
+        random_device rd;
+        baseSeed = rd();
+        gen.seed(static_cast<unsigned>(baseSeed));
+        resetMasks();
+        density.reset(size);
+    }
+
+    bool inBounds(int x, int y) const
+    {
+        return (x >= 0 && x < size && y >= 0 && y < size);
+    }
+
+    Organism *getCell(int x, int y) const
+    {
+        if (!inBounds(x, y))
+            return nullptr;
+        return orgs.get(grid[x][y]);
+    }
+
+    void setCell(int x, int y, Organism *org)
+    {
+        if (!inBounds(x, y))
+            return;
+        track(x, y, orgs.get(grid[x][y]), org);
+        grid[x][y] = org ? org->getHandle() : NO_ORG;
+    }
+
+    /**
+     * Removes occupant from the grid and from the organism table
+     */
+    void deleteCell(int x, int y)
+    {
+        if (!inBounds(x, y))
+            return;
+        Organism *toDelete = orgs.get(grid[x][y]);
+        if (toDelete)
+        {
+            logEvent(toDelete->getCharacter() == 'X' ? EVENT_DOODLE_DEATH : EVENT_ANT_DEATH, x, y);
+            if (isParked(grid[x][y]))
+                parkedAt[OrgSlots::indexOf(grid[x][y])] = -1;
+            traits.drop(OrgSlots::indexOf(grid[x][y]), toDelete->getCharacter() == 'X');
+            orgs.remove(grid[x][y]);
+            track(x, y, toDelete, nullptr);
+            delete toDelete;
+            grid[x][y] = NO_ORG;
+        }
+    }
+
+    /**
+     * Direction masks (see DIRS) of the empty and the ant-occupied
+     * neighbors of (x, y)
+     */
+    unsigned freeNeighbors(int x, int y) const { return neighborMasks[x * size + y] & FREE_BITS; }
+    unsigned antNeighbors(int x, int y) const { return neighborMasks[x * size + y] >> ANT_SHIFT; }
+
+    Directions getNeighbors(int x, int y) const
+    {
+        Directions result;
+        for (auto &d : DIRS)
+        {
+            int nx = x + d[0];
+            int ny = y + d[1];
+            if (inBounds(nx, ny))
+            {
+                result.push_back({nx, ny});
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Reseeds the world's generator; two worlds with the same seed,
+     * state and engine evolve identically.
+     */
+    void seed(unsigned s)
+    {
+        gen.seed(s);
+        baseSeed = s;
+    }
+
+    mt19937 &rng() { return gen; }
+
+    int getAge() const { return age; }
+
+    /**
+     * Starts a step (advances the counter and releases the organism slots
+     * freed during the last one); for engines that step the world themselves
+     */
+    void tick()
+    {
+        orgs.recycle();
+        age++;
+    }
+
+    /**
+     * Every live organism. Breed counters of ants parked by update()
+     * lag behind; read them with breedCountOf.
+     */
+    const vector<OrgHandle> &organisms() const { return orgs.all(); }
+
+    int breedCountOf(const Organism *o) const
+    {
+        if (!isParked(o->getHandle()))
+            return o->getBreedCount();
+        uint32_t idx = OrgSlots::indexOf(o->getHandle());
+        return idleBreedCount(o->getBreedCount(), age - parkedAt[idx], traits.breed(idx));
+    }
+
+    Organism *lookup(OrgHandle h) const { return orgs.get(h); }
+
+    /**
+     * Order-sensitive 64-bit hash of every occupant and its counters
+     */
+    uint64_t checksum() const
+    {
+        uint64_t h = mix64(static_cast<uint64_t>(size) << 32 | static_cast<uint32_t>(age));
+        for (int x = 0; x < size; x++)
+        {
+            for (int y = 0; y < size; y++)
+            {
+                Organism *o = orgs.get(grid[x][y]);
+                if (!o)
+                    continue;
+                const Doodlebug *d = dynamic_cast<const Doodlebug *>(o);
+                uint64_t v = static_cast<uint64_t>(x * size + y) << 24 |
+                             static_cast<uint64_t>(o->getCharacter()) << 16 |
+                             static_cast<uint64_t>(breedCountOf(o) & 0xff) << 8 |
+                             static_cast<uint64_t>(d ? d->getStarveCount() & 0xff : 0);
+                h = mix64(h ^ v);
+                if (foodOn && !d)
+                    h = mix64(h ^ static_cast<uint64_t>(static_cast<const Ant *>(o)->getEnergy()));
+            }
+        }
+        return h;
+    }
+
+    /**
+     * Turns the doodlebug scent layer on (starting from no scent) or off
+     */
+    void setScent(bool on, const ScentOptions &opts = ScentOptions())
+    {
+        scentOn = on;
+        scentOpts = opts;
+        if (on)
+            scent.reset(size);
+        else
+            scent = ScentField();
+    }
+
+    bool hasScent() const { return scentOn; }
+
+    float scentAt(int x, int y) const { return scentOn ? scent.at(x * size + y) : 0.0f; }
+
+    /**
+     * Direction for an ant at (x, y) to move in, from its free mask:
+     * uniform, or weighted away from doodlebug scent when that layer is
+     * on; -1 if the mask is empty
+     */
+    int pickAntMove(unsigned mask, int x, int y, mt19937 &gen) const
+    {
+        if (!scentOn)
+            return pickDirection(mask, gen);
+        if (!mask)
+            return -1;
+        return scentedDirection(mask, x, y, uniform_real_distribution<double>(0, 1)(gen));
+    }
+
+    /**
+     * Turns the food layer on (every cell full) or off. Off, ants breed
+     * on their timer alone.
+     */
+    void setFood(bool on, const FoodOptions &opts = FoodOptions())
+    {
+        foodOn = on;
+        foodOpts = opts;
+        if (on)
+            food.reset(static_cast<size_t>(size) * size, opts.capacity);
+        else
+            food = FoodField();
+    }
+
+    bool hasFood() const { return foodOn; }
+
+    int foodAt(int x, int y) const { return foodOn ? food.at(x * size + y) : 0; }
+
+    /**
+     * An ant that has just moved eats from its new cell
+     */
+    void graze(Ant &a)
+    {
+        if (foodOn)
+            a.setEnergy(a.getEnergy() + food.eat(a.getX() * size + a.getY(), foodOpts.meal));
+    }
+
+    bool canAffordBirth(const Ant &a) const { return !foodOn || a.getEnergy() >= foodOpts.birthCost; }
+
+    void payForBirth(Ant &a)
+    {
+        if (foodOn)
+            a.setEnergy(a.getEnergy() - foodOpts.birthCost);
+    }
+
+    /**
+     * Thresholds of o's heritable traits (see TraitTable)
+     */
+    int breedLimit(const Organism *o) const { return traits.breed(OrgSlots::indexOf(o->getHandle())); }
+    int starveLimit(const Organism *o) const { return traits.starve(OrgSlots::indexOf(o->getHandle())); }
+
+    /**
+     * Turns trait mutation at birth on (each trait of a newborn moves one
+     * step from its parent's with probability rate) or off (newborns
+     * copy their parent exactly)
+     */
+    void setEvolution(bool on, double rate = 0.05)
+    {
+        evolving = on;
+        mutationRate = rate;
+    }
+
+    bool isEvolving() const { return evolving; }
+
+    /**
+     * Switches between breeding on a counter and breeding with
+     * probability 1 / breed limit each turn (see stochasticBreeding)
+     */
+    void setStochasticBreeding(bool on)
+    {
+        stochasticBreeding = on;
+        if (!on)
+            return;
+        for (auto h : orgs.all())
+        {
+            reserveBreedDue(h);
+            scheduleBreeding(orgs.get(h), age);
+        }
+    }
+
+    bool isBreedingStochastic() const { return stochasticBreeding; }
+
+    /**
+     * Whether o breeds on this turn, its breed counter already advanced:
+     * on reaching its breed limit, or with stochastic breeding when its
+     * scheduled step comes (which schedules the next one)
+     */
+    bool readyToBreed(Organism *o)
+    {
+        if (!stochasticBreeding)
+            return o->getBreedCount() >= breedLimit(o);
+        if (breedDue[OrgSlots::indexOf(o->getHandle())] > age)
+            return false;
+        scheduleBreeding(o, age);
+        return true;
+    }
+
+    TraitSummary traitSummary(bool doodlebugs) const { return traits.summary(doodlebugs); }
+
+    const PhaseTimings &getTimings() const { return timings; }
+
+    OscillationStats oscillationStats() const { return oscillation.stats(); }
+
+    /**
+     * Restarts the cycle estimate with running means over about window steps
+     */
+    void setOscillationWindow(int window) { oscillation.reset(window); }
+
+    int getOscillationWindow() const { return oscillation.getWindow(); }
+
+    void resetTimings() { timings = PhaseTimings(); }
+
+    /**
+     * Enables per-step consistency checks (see ValidationOptions)
+     */
+    void setValidation(const ValidationOptions &opts)
+    {
+        validation = opts;
+        checkGen.seed(static_cast<unsigned>(time(nullptr)));
+    }
+
+    const ValidationOptions &getValidation() const { return validation; }
+
+    long getViolations() const { return violations; }
+
+    /**
+     * Checks grid/organism consistency, either on a random sample or
+     * everywhere. Returns the number of violations found.
+     */
+    long validate(bool full)
+    {
+        long before = violations;
+        if (full)
+        {
+            size_t occupied = 0;
+            for (int x = 0; x < size; x++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    checkCell(x, y);
+                    occupied += (grid[x][y] != NO_ORG);
+                }
+            }
+            int ants = 0, doodles = 0;
+            for (auto h : orgs.all())
+            {
+                checkOrganism(h);
+                if (Organism *o = orgs.get(h))
+                    (o->getCharacter() == 'X' ? doodles : ants)++;
+            }
+            if (occupied != orgs.count())
+                violation("occupied cells and organism count differ", -1, -1);
+            int top = density.maxLevel();
+            if (top > 0 && (density.ants(top, 0, 0) != ants || density.doodles(top, 0, 0) != doodles))
+                violation("density pyramid out of date", -1, -1);
+        }
+        else
+        {
+            uniform_int_distribution<int> cell(0, size - 1);
+            for (int i = 0; i < validation.sampleCells; i++)
+                checkCell(cell(checkGen), cell(checkGen));
+            const vector<OrgHandle> &all = orgs.all();
+            for (int i = 0; i < validation.sampleOrgs && !all.empty(); i++)
+                checkOrganism(all[checkGen() % all.size()]);
+        }
+        return violations - before;
+    }
+
+    /**
+     * Attaches an event log (nullptr detaches); the world does not own it.
+     * Steps ending at or before age `after` are not logged, for steps
+     * replayed after going back in time.
+     */
+    void setEventLog(EventLog *log, int after = -1)
+    {
+        events = log;
+        logAfter = after;
+    }
+
+    EventLog *getEventLog() const { return events; }
+
+    /**
+     * Records an event at (x, y) caused by the organism at (px, py), if any
+     */
+    void logEvent(uint8_t type, int x, int y, int px = -1, int py = -1)
+    {
+        if (!events || age <= logAfter)
+            return;
+        uint32_t parent = (px < 0) ? NO_CELL : static_cast<uint32_t>(px * size + py);
+        events->emit(age, type, static_cast<uint32_t>(x * size + y), parent);
+    }
+
+    // Create an Ant, bred by the organism at (px, py), and track it in the organism table
+    void createAnt(int x, int y, int px = -1, int py = -1)
+    {
+        if (!getCell(x, y))
+        {
+            Ant *a = new Ant(x, y);
+            orgs.insert(a);
+            registerBirth(a, px, py);
+            if (parking)
+                active.push_back(a->getHandle());
+            setCell(x, y, a);
+            logEvent(EVENT_ANT_BIRTH, x, y, px, py);
+        }
+    }
+
+    // Create a Doodlebug, bred by the organism at (px, py), and track it in the organism table
+    void createDoodlebug(int x, int y, int px = -1, int py = -1)
+    {
+        if (!getCell(x, y))
+        {
+            Doodlebug *d = new Doodlebug(x, y);
+            orgs.insert(d);
+            registerBirth(d, px, py);
+            if (parking)
+                active.push_back(d->getHandle());
+            setCell(x, y, d);
+            logEvent(EVENT_DOODLE_BIRTH, x, y, px, py);
+        }
+    }
+
+    /**
+     * Places the initial set of ants & doodles
+     */
+    void initialize()
+    {
+        initialize(INIT_ANTS, INIT_DOODLES);
+    }
+
+    /**
+     * Places the given numbers of ants & doodles at random
+     */
+    void initialize(int ants, int doodles)
+    {
+        int placedAnts = 0;
+        int placedDoodles = 0;
+        doodles = min(doodles, size * size);
+        ants = min(ants, size * size - doodles);
+
+        while (placedDoodles < doodles)
+        {
+            int x = gen() % size;
+            int y = gen() % size;
+            if (!getCell(x, y))
+            {
+                createDoodlebug(x, y);
+                placedDoodles++;
+            }
+        }
+
+        while (placedAnts < ants)
+        {
+            int x = gen() % size;
+            int y = gen() % size;
+            if (!getCell(x, y))
+            {
+                createAnt(x, y);
+                placedAnts++;
+            }
+        }
+    }
+
+    /**
+     * We take a snapshot of the active handles to avoid issues
+     * if an organism gets deleted/bred during iteration. Parked ants
+     * (see park) are left out, so a saturated world costs time in
+     * proportion to its active frontier.
+     */
+    void update()
+    {
+        auto started = chrono::steady_clock::now();
+        orgs.recycle();
+        age++;
+        if (!parking)
+        {
+            active = orgs.all();
+            parking = true;
+        }
+        // Build a snapshot
+        turnOrder.swap(active);
+        active.clear();
+
+        // Shuffle snapshot to randomize update order
+        shuffle(turnOrder.begin(), turnOrder.end(), gen);
+
+        // For each occupant in the snapshot (wake may append more)
+        for (turnIndex = 0; turnIndex < static_cast<int>(turnOrder.size()); turnIndex++)
+        {
+            // If it was removed in the middle (starved or eaten), its
+            // generation moved on and the handle no longer resolves
+            OrgHandle h = turnOrder[turnIndex];
+            Organism *o = orgs.get(h);
+            if (!o)
+                continue;
+
+            o->update(*this);
+
+            o = orgs.get(h);
+            if (!o)
+                continue;
+            if (o->getCharacter() == 'o' && !freeNeighbors(o->getX(), o->getY()))
+                park(h);
+            else
+                active.push_back(h);
+        }
+        turnIndex = -1;
+        turnOrder.clear();
+
+        timings.engineMs += msSince(started);
+        afterStep();
+    }
+
+    /**
+     * Smallest number of list items per thread in updateParallel;
+     * lower it to exercise threading on small worlds
+     */
+    void setParallelGrain(int items) { parallelGrain = max(1, items); }
+
+    /**
+     * Parallel step whose result depends only on the seed, never on the
+     * thread count. Instead of one shuffled sequence, organisms are dealt
+     * into ORDER_BATCHES random batches; within a batch, doodlebugs
+     * starve, eat or move, then breed, and ants move, then breed, each
+     * species all at once. Every choice comes from counterRandom(seed,
+     * step, stream, cell) and two organisms after the same cell are
+     * settled by a counter-based priority (losers retry, see claimRounds).
+     * Proposals and conflict resolution run on several threads; moves and
+     * births are applied serially in a fixed order.
+     */
+    void updateParallel(int threads)
+    {
+        auto started = chrono::steady_clock::now();
+        unpark();
+        orgs.recycle();
+        age++;
+        if (want.size() != static_cast<size_t>(size) * size)
+        {
+            want.assign(static_cast<size_t>(size) * size, -1);
+            breeder.assign(static_cast<size_t>(size) * size, NO_ORG);
+        }
+
+        // Deal everyone alive now into random batches. The organism list
+        // order only depends on past births and deaths, which are applied
+        // in a fixed order, so this is the same at any thread count.
+        batchAnts.resize(ORDER_BATCHES);
+        batchDoodles.resize(ORDER_BATCHES);
+        for (int b = 0; b < ORDER_BATCHES; b++)
+        {
+            batchAnts[b].clear();
+            batchDoodles[b].clear();
+        }
+        for (auto h : orgs.all())
+        {
+            Organism *o = orgs.get(h);
+            int b = counterRandom(baseSeed, age, PHASE_ORDER, o->getId()) % ORDER_BATCHES;
+            (o->getCharacter() == 'X' ? batchDoodles : batchAnts)[b].push_back(h);
+        }
+
+        // Within a batch, which species goes first is a coin flip
+        for (batch = 0; batch < ORDER_BATCHES; batch++)
+        {
+            if (draw(PHASE_COIN, 0) & 1)
+            {
+                parallelAnts(threads, batchAnts[batch]);
+                parallelDoodlebugs(threads, batchDoodles[batch]);
+            }
+            else
+            {
+                parallelDoodlebugs(threads, batchDoodles[batch]);
+                parallelAnts(threads, batchAnts[batch]);
+            }
+        }
+        batch = 0;
+
+        timings.engineMs += msSince(started);
+        afterStep();
+    }
+
+    /**
+     * Takes up to `steps` steps in one call, with the engine choice and
+     * the sampling/stop schedule worked out once. Returns the number of
+     * steps taken.
+     */
+    int run(int steps, const RunOptions &opts = RunOptions())
+    {
+        int sampleEvery = opts.onSample ? opts.sampleEvery : 0;
+        int checkEvery = (opts.stopOnExtinction || opts.stopWhenStationary || opts.stopWhen) ? max(1, opts.checkEvery) : 0;
+        int done = 0;
+        while (done < steps)
+        {
+            if (opts.threads > 0)
+                updateParallel(opts.threads);
+            else
+                update();
+            done++;
+            if (sampleEvery > 0 && done % sampleEvery == 0)
+                opts.onSample(*this);
+            if (checkEvery > 0 && done % checkEvery == 0)
+            {
+                if (opts.stopOnExtinction && (antCount() == 0 || doodleCount() == 0))
+                    break;
+                if (opts.stopWhenStationary && oscillation.stats().stationary)
+                    break;
+                if (opts.stopWhen && opts.stopWhen(*this))
+                    break;
+            }
+        }
+        return done;
+    }
+
+    int getSize() const { return size; }
+
+    /**
+     * Connected clusters of each species (see ClusterLabeler)
+     */
+    ClusterStats clusters() const { return clusterLabeler.label(kinds.data(), size, defaultBands()); }
+
+    /**
+     * Power spectra of the densities in blocks of 2^level cells a side
+     * (see SpectrumAnalyzer); level 0 picks the finest level with at most
+     * 256 blocks a side
+     */
+    SpectrumStats spectrum(int level = 0) const
+    {
+        if (density.maxLevel() == 0)
+            return SpectrumStats();
+        if (level <= 0)
+            for (level = 1; level < density.maxLevel() && ((size - 1) >> level) + 1 > 256; level++)
+                ;
+        level = min(level, density.maxLevel());
+        return spectrumAnalyzer.analyze(density, level, size, defaultBands());
+    }
+
+    int antCount() const { return density.totalAnts(); }
+    int doodleCount() const { return density.totalDoodles(); }
+
+    /**
+     * Counts and adjacency statistics from the packed cell kinds, split
+     * across row bands. SSE2 compares feed byte counters that are summed
+     * with psadbw (see censusCount). Pairs are the neighbors of the
+     * neighborhood in force, so diagonals count under NEIGHBORHOOD 8.
+     */
+    Census census() const
+    {
+        int bands = max(1, min(defaultBands(), size / 256));
+        vector<Census> parts(bands);
+        parallelBands(size, bands, [&](int b, int begin, int end)
+                      {
+            Census &c = parts[b];
+            for (int x = begin; x < end; x++)
+            {
+                const uint8_t *row = &kinds[static_cast<size_t>(x) * size];
+                censusCount(row, size, c);
+                censusPairs(row, row + 1, size - 1, c);
+                if (x + 1 < size)
+                {
+                    censusPairs(row, row + size, size, c);
+#if NEIGHBORHOOD == 8
+                    censusPairs(row, row + size + 1, size - 1, c); // down and right
+                    censusPairs(row + 1, row + size, size - 1, c); // down and left
+#endif
+                }
+            } });
+        Census total;
+        for (auto &part : parts)
+            total.add(part);
+        total.cells = static_cast<long>(size) * size;
+        return total;
+    }
+
+    const LineageTable &getLineage() const { return lineage; }
+
+    /**
+     * Approximate bytes held by a copy of this world (the lineage chunks
+     * a copy shares are not counted)
+     */
+    size_t footprint() const
+    {
+        size_t cells = static_cast<size_t>(size) * size;
+        size_t perCell = sizeof(OrgHandle) + 1 + sizeof(NeighborMask) + 3 * sizeof(int) + // grid, kinds, masks, density
+                         (scentOn ? 2 * sizeof(float) : 0) + (foodOn ? 1 : 0);
+        // Per organism: the object and its allocation header, then the
+        // slot, generation, position, trait, breeding and parking entries
+        size_t perOrg = sizeof(Doodlebug) + 16 + sizeof(Organism *) + 1 + 4 + 2 + 2 * sizeof(int);
+        return sizeof(World) + cells * perCell + orgs.count() * perOrg + lineage.unsharedBytes();
+    }
+
+    /**
+     * (founder, living descendants including the founder) per founder
+     * with any survivors, largest first
+     */
+    vector<pair<uint32_t, uint32_t>> livingByFounder() const
+    {
+        vector<uint32_t> f = lineage.founders();
+        if (f.empty())
+            return {};
+        map<uint32_t, uint32_t> counts;
+        for (auto h : orgs.all())
+            counts[f[orgs.get(h)->getId()]]++;
+        vector<pair<uint32_t, uint32_t>> result(counts.begin(), counts.end());
+        stable_sort(result.begin(), result.end(), [](const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b)
+                    { return a.second > b.second; });
+        return result;
+    }
+
+    /**
+     * Serializes the world into a compressed checkpoint. Layout:
+     * "DBCK", version, size, age, band count, band byte lengths, then
+     * the bands, each encoded independently on its own thread.
+     */
+    void encodeCheckpoint(vector<uint8_t> &out) const
+    {
+        int bands = max(1, min(defaultBands(), size));
+        vector<vector<uint8_t>> parts(bands);
+        parallelBands(size, bands, [&](int b, int begin, int end)
+                      { encodeBand(begin, end, parts[b]); });
+
+        out.clear();
+        for (char c : string("DBCK"))
+            out.push_back(static_cast<uint8_t>(c));
+        // Version 2 adds optional layers after the bands
+        bool withTraits = evolving || traitsSaved;
+        uint32_t layers = 0;
+        if (scentOn)
+            layers |= LAYER_SCENT;
+        if (foodOn)
+            layers |= LAYER_FOOD;
+        if (withTraits)
+            layers |= LAYER_TRAITS;
+        if (stochasticBreeding)
+            layers |= LAYER_BREEDING;
+        putU32(out, layers ? 2 : 1);
+        putU32(out, size);
+        putU32(out, age);
+        putU32(out, bands);
+        for (auto &part : parts)
+            putU32(out, static_cast<uint32_t>(part.size()));
+        for (auto &part : parts)
+            out.insert(out.end(), part.begin(), part.end());
+        if (!layers)
+            return;
+        putU32(out, layers);
+        if (scentOn)
+        {
+            for (float v : {scentOpts.deposit, scentOpts.spread, scentOpts.decay, scentOpts.avoidance})
+                putFloat(out, v);
+            for (float v : scent.values())
+                putFloat(out, v);
+        }
+        if (foodOn)
+        {
+            for (uint8_t v : {foodOpts.capacity, foodOpts.regrow, foodOpts.meal, foodOpts.birthCost})
+                out.push_back(v);
+            out.insert(out.end(), food.values().begin(), food.values().end());
+            // Ant energies, in the row-major order the bands list organisms
+            for (int x = 0; x < size; x++)
+                for (int y = 0; y < size; y++)
+                    if (kinds[x * size + y] == KIND_ANT)
+                        putVarint(out, static_cast<uint32_t>(static_cast<const Ant *>(getCell(x, y))->getEnergy()));
+        }
+        if (withTraits)
+        {
+            // Mutation settings, then each organism's traits in row-major order
+            out.push_back(evolving);
+            putFloat(out, static_cast<float>(mutationRate));
+            for (int x = 0; x < size; x++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    Organism *o = getCell(x, y);
+                    if (!o)
+                        continue;
+                    out.push_back(static_cast<uint8_t>(breedLimit(o)));
+                    if (kinds[x * size + y] == KIND_DOODLE)
+                        out.push_back(static_cast<uint8_t>(starveLimit(o)));
+                }
+            }
+        }
+        if (stochasticBreeding)
+        {
+            // Steps from now to each organism's next breeding turn
+            for (int x = 0; x < size; x++)
+                for (int y = 0; y < size; y++)
+                    if (Organism *o = getCell(x, y))
+                        putVarint(out, static_cast<uint32_t>(max(0, breedDue[OrgSlots::indexOf(o->getHandle())] - age)));
+        }
+    }
+
+    /**
+     * Replaces the world with a checkpoint made by encodeCheckpoint. The
+     * data is decoded into a new world with this one's seed and run
+     * settings, which takes over only once every part has decoded, so
+     * malformed data leaves the world and its layers as they were.
+     */
+    bool decodeCheckpoint(const vector<uint8_t> &in)
+    {
+        World loaded(1);
+        loaded.events = events;
+        loaded.logAfter = logAfter;
+        loaded.validation = validation;
+        loaded.timings = timings;
+        loaded.oscillation.reset(oscillation.getWindow());
+        loaded.gen = gen;
+        loaded.baseSeed = baseSeed;
+        loaded.checkGen = checkGen;
+        loaded.violations = violations;
+        loaded.parallelGrain = parallelGrain;
+        if (!loaded.decodeFresh(in))
+            return false;
+        *this = move(loaded);
+        return true;
+    }
+
+    /**
+     * Replaces the world with a text map (see scanMapRow). Leading lines
+     * starting with "World at iteration N" set the age; blank lines are
+     * skipped. The world is sized to fit the longest side. The file is
+     * memory-mapped and scanned twice: once for the size, once to build.
+     */
+    bool loadMap(const string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        size_t len = static_cast<size_t>(st.st_size);
+        void *mapped = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        madvise(mapped, len, MADV_SEQUENTIAL);
+        const char *begin = static_cast<const char *>(mapped);
+        const char *end = begin + len;
+
+        // Finds the data rows, calling fn(row, lineStart, lineEnd) for each
+        int newAge = 0;
+        auto forEachRow = [&](const function<bool(int, const char *, const char *)> &fn)
+        {
+            int row = 0;
+            for (const char *p = begin; p < end;)
+            {
+                const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+                const char *lineEnd = nl ? nl : end;
+                const char *q = p;
+                while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r'))
+                    q++;
+                if (q < lineEnd && row == 0 && *q == 'W')
+                {
+                    const char *tag = "World at iteration ";
+                    size_t tagLen = strlen(tag);
+                    if (static_cast<size_t>(lineEnd - q) > tagLen && equal(tag, tag + tagLen, q))
+                        newAge = max(0, atoi(q + tagLen) - 1);
+                }
+                else if (q < lineEnd)
+                {
+                    if (!fn(row, q, lineEnd))
+                        return false;
+                    row++;
+                }
+                p = lineEnd + 1;
+            }
+            return true;
+        };
+
+        int rows = 0, maxCols = 0;
+        bool ok = forEachRow([&](int row, const char *p, const char *e)
+                             {
+            int cols;
+            if (!scanMapRow(p, e, cols, [](int, char) {}))
+                return false;
+            rows = row + 1;
+            maxCols = max(maxCols, cols);
+            return true; });
+        if (ok && max(rows, maxCols) > MAX_SIZE)
+        {
+            cerr << "Maps are limited to " << MAX_SIZE << " x " << MAX_SIZE << " cells\n";
+            ok = false;
+        }
+        if (ok && max(rows, maxCols) > 0)
+        {
+            clear(max(rows, maxCols));
+            age = newAge;
+            forEachRow([&](int row, const char *p, const char *e)
+                       {
+                int cols;
+                return scanMapRow(p, e, cols, [&](int col, char c)
+                                  { place(c == 'o' ? static_cast<Organism *>(new Ant(row, col))
+                                                   : static_cast<Organism *>(new Doodlebug(row, col))); }); });
+            rebuildDensity();
+        }
+        munmap(mapped, len);
+        return ok && rows > 0;
+    }
+
+    bool saveCheckpoint(const string &path) const
+    {
+        vector<uint8_t> data;
+        encodeCheckpoint(data);
+        ofstream out(path, ios::binary);
+        out.write(reinterpret_cast<const char *>(data.data()), data.size());
+        return static_cast<bool>(out);
+    }
+
+    bool loadCheckpoint(const string &path)
+    {
+        ifstream in(path, ios::binary);
+        if (!in)
+            return false;
+        vector<uint8_t> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        return decodeCheckpoint(data);
+    }
+
+    /**
+     * Largest useful zoom: one character covers the whole world
+     */
+    int maxZoom() const { return density.maxLevel(); }
+
+    /**
+     * The character for block (bx, by) at a zoom level: the occupant's
+     * glyph or '-' at zoom 0, a density glyph above that
+     */
+    char glyph(int bx, int by, int zoom) const
+    {
+        if (zoom == 0)
+        {
+            Organism *o = getCell(bx, by);
+            return o ? o->getCharacter() : '-';
+        }
+        int span = 1 << zoom;
+        int h = min(span, size - (bx << zoom));
+        int wd = min(span, size - (by << zoom));
+        return densityGlyph(density.ants(zoom, bx, by), density.doodles(zoom, bx, by), h * wd);
+    }
+
+    /**
+     * Renders only the cells inside the viewport. At zoom 0 the output
+     * matches operator<<; above that each character summarizes a block
+     * from the density pyramid, so cost depends on screen size only.
+     */
+    void render(ostream &os, const Viewport &v) const
+    {
+        int blocks = ((size - 1) >> v.zoom) + 1;
+        int rowEnd = min(blocks, v.top + v.rows);
+        int colEnd = min(blocks, v.left + v.cols);
+
+        os << "World at iteration " << (age + 1);
+        if (v.zoom > 0 || v.top > 0 || v.left > 0 || rowEnd < blocks || colEnd < blocks)
+        {
+            os << " [rows " << (v.top << v.zoom) << "-" << min(size, rowEnd << v.zoom) - 1
+               << ", cols " << (v.left << v.zoom) << "-" << min(size, colEnd << v.zoom) - 1
+               << ", zoom " << v.zoom << "]";
+        }
+        os << ":\n";
+
+        for (int bx = v.top; bx < rowEnd; bx++)
+        {
+            for (int by = v.left; by < colEnd; by++)
+                os << glyph(bx, by, v.zoom) << ' ';
+            os << "\n";
+        }
+    }
+
+    friend ostream &operator<<(ostream &os, const World &w)
+    {
+        os << "World at iteration " << (w.age + 1) << ":\n";
+        for (int x = 0; x < w.size; x++)
+        {
+            for (int y = 0; y < w.size; y++)
+            {
+                if (Organism *o = w.getCell(x, y))
+                    os << o << ' ';
+                else
+                    os << "- ";
+            }
+            os << "\n";
+        }
+        return os;
+    }
+};
+
+/**
+ * Ant::update(World&)
+ * 1) Move (random)
+ * 2) Breed when due (World::readyToBreed)
+ */
+void Ant::update(World &w)
+{
+    // Moving and breeding both look around the cell the ant started in
+    int ox = getX(), oy = getY();
+    mt19937 &gen = w.rng();
+
+    // (1) Attempt to move
+    int d = w.pickAntMove(w.freeNeighbors(ox, oy), ox, oy, gen);
+    if (d >= 0)
+    {
+        int nx = ox + DIRS[d][0];
+        int ny = oy + DIRS[d][1];
+        w.setCell(nx, ny, this);
+        w.setCell(ox, oy, nullptr);
+        setPos(nx, ny);
+        w.graze(*this);
+    }
+
+    // (2) Breed, if fed enough when there is a food layer
+    incBreed();
+    if (w.readyToBreed(this))
+    {
+        if (w.canAffordBirth(*this))
+        {
+            d = pickDirection(w.freeNeighbors(ox, oy), gen);
+            if (d >= 0)
+            {
+                w.createAnt(ox + DIRS[d][0], oy + DIRS[d][1], getX(), getY());
+                w.payForBirth(*this);
+            }
+        }
+        resetBreed();
+    }
+}
+
+/**
+ * Doodlebug::update(World&)
+ * 1) Starve check
+ * 2) Attempt to eat
+ * 3) If no eat, move
+ * 4) Breed when due (World::readyToBreed)
+ */
+void Doodlebug::update(World &w)
+{
+    // 1) Starve check
+    if (starveCount >= w.starveLimit(this))
+    {
+        w.deleteCell(getX(), getY());
+        return;
+    }
+
+    int ox = getX(), oy = getY();
+    mt19937 &gen = w.rng();
+
+    // 2) Attempt to eat an adjacent Ant
+    int d = pickDirection(w.antNeighbors(ox, oy), gen);
+    if (d >= 0)
+    {
+        // Eat (remove occupant) and move
+        int nx = ox + DIRS[d][0];
+        int ny = oy + DIRS[d][1];
+        w.logEvent(EVENT_PREDATION, nx, ny, ox, oy);
+        w.deleteCell(nx, ny);
+        w.setCell(nx, ny, this);
+        w.setCell(ox, oy, nullptr);
+        setPos(nx, ny);
+        starveCount = 0;
+    }
+    // 3) If didn't eat, try to move
+    else
+    {
+        d = pickDirection(w.freeNeighbors(ox, oy), gen);
+        if (d >= 0)
+        {
+            int nx = ox + DIRS[d][0];
+            int ny = oy + DIRS[d][1];
+            w.setCell(nx, ny, this);
+            w.setCell(ox, oy, nullptr);
+            setPos(nx, ny);
+        }
+        // If we didn't eat, increment starveCount
+        // even if we moved. The doodlebug starves if it doesn't eat
+        // for DOODLE_STARVE turns.
+        starveCount++;
+    }
+
+    // 4) Breed
+    incBreed();
+    if (w.readyToBreed(this))
+    {
+        d = pickDirection(w.freeNeighbors(ox, oy), gen);
+        if (d >= 0)
+            w.createDoodlebug(ox + DIRS[d][0], oy + DIRS[d][1], getX(), getY());
+        resetBreed();
+    }
+}
+
+/*
+ * Reference engine: the original World::update, Ant::update and
+ * Doodlebug::update rules, frozen here so optimized engines always have
+ * something to be compared with. Every rule lives here (neighbors,
+ * thresholds, the order of eating, moving and breeding); the World is
+ * only asked to keep its books (cells, the organism table, births and
+ * deaths). The only setting shared with the other engines is the
+ * compile-time NEIGHBORHOOD. Do not optimize these.
+ */
+static const int REFERENCE_DIRS[][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}
+#if NEIGHBORHOOD == 8
+                                        ,
+                                        {1, 1}, {-1, -1}, {1, -1}, {-1, 1}
+#endif
+};
+
+static Directions referenceNeighbors(const World &w, int x, int y)
+{
+    Directions result;
+    for (auto &d : REFERENCE_DIRS)
+        if (w.inBounds(x + d[0], y + d[1]))
+            result.push_back({x + d[0], y + d[1]});
+    return result;
+}
+
+static void referenceAnt(World &w, Ant *a)
+{
+    Directions neighbors = referenceNeighbors(w, a->getX(), a->getY());
+    mt19937 &gen = w.rng();
+    shuffle(neighbors.begin(), neighbors.end(), gen);
+    for (auto &nbr : neighbors)
+    {
+        if (!w.getCell(nbr.first, nbr.second))
+        {
+            w.setCell(nbr.first, nbr.second, a);
+            w.setCell(a->getX(), a->getY(), nullptr);
+            a->setPos(nbr.first, nbr.second);
+            break;
+        }
+    }
+
+    a->incBreed();
+    if (a->getBreedCount() >= ANT_BREED)
+    {
+        shuffle(neighbors.begin(), neighbors.end(), gen);
+        for (auto &nbr : neighbors)
+        {
+            if (!w.getCell(nbr.first, nbr.second))
+            {
+                w.createAnt(nbr.first, nbr.second, a->getX(), a->getY());
+                break;
+            }
+        }
+        a->resetBreed();
+    }
+}
+
+static void referenceDoodlebug(World &w, Doodlebug *d)
+{
+    if (d->getStarveCount() >= DOODLE_STARVE)
+    {
+        w.deleteCell(d->getX(), d->getY());
+        return;
+    }
+
+    bool ate = false;
+    Directions neighbors = referenceNeighbors(w, d->getX(), d->getY());
+    mt19937 &gen = w.rng();
+    shuffle(neighbors.begin(), neighbors.end(), gen);
+    for (auto &nbr : neighbors)
+    {
+        if (dynamic_cast<Ant *>(w.getCell(nbr.first, nbr.second)))
+        {
+            w.logEvent(EVENT_PREDATION, nbr.first, nbr.second, d->getX(), d->getY());
+            w.deleteCell(nbr.first, nbr.second);
+            w.setCell(nbr.first, nbr.second, d);
+            w.setCell(d->getX(), d->getY(), nullptr);
+            d->setPos(nbr.first, nbr.second);
+            ate = true;
+            d->setStarveCount(0);
+            break;
+        }
+    }
+
+    if (!ate)
+    {
+        shuffle(neighbors.begin(), neighbors.end(), gen);
+        for (auto &nbr : neighbors)
+        {
+            if (!w.getCell(nbr.first, nbr.second))
+            {
+                w.setCell(nbr.first, nbr.second, d);
+                w.setCell(d->getX(), d->getY(), nullptr);
+                d->setPos(nbr.first, nbr.second);
+                break;
+            }
+        }
+        d->setStarveCount(d->getStarveCount() + 1);
+    }
+
+    d->incBreed();
+    if (d->getBreedCount() >= DOODLE_BREED)
+    {
+        shuffle(neighbors.begin(), neighbors.end(), gen);
+        for (auto &nbr : neighbors)
+        {
+            if (!w.getCell(nbr.first, nbr.second))
+            {
+                w.createDoodlebug(nbr.first, nbr.second, d->getX(), d->getY());
+                break;
+            }
+        }
+        d->resetBreed();
+    }
+}
+
+void referenceStep(World &w)
+{
+    w.tick();
+    vector<OrgHandle> snapshot = w.organisms();
+    shuffle(snapshot.begin(), snapshot.end(), w.rng());
+    for (auto h : snapshot)
+    {
+        Organism *o = w.lookup(h);
+        if (!o)
+            continue;
+        if (Doodlebug *d = dynamic_cast<Doodlebug *>(o))
+            referenceDoodlebug(w, d);
+        else
+            referenceAnt(w, static_cast<Ant *>(o));
+    }
+}
+
+/**
+ * Engine: one way of advancing a World by a step. The engines draw from
+ * the generator differently than the reference (e.g. one pick per
+ * decision instead of a shuffle), so they only have to match it
+ * statistically.
+ */
+struct Engine
+{
+    string name;
+    function<void(World &)> step;
+};
+
+/**
+ * Engines checked by --diff against referenceStep
+ */
+vector<Engine> candidateEngines()
+{
+    return {
+        {"World::update", [](World &w)
+         { w.update(); }},
+        {"World::updateParallel", [](World &w)
+         { w.updateParallel(defaultBands()); }},
+    };
+}
+
+/**
+ * Welch's t statistic and a two-sided p-value for equal means. The
+ * p-value uses the normal approximation, fine for 30+ seeds.
+ */
+static double welchP(const vector<double> &a, const vector<double> &b, double &t)
+{
+    auto moments = [](const vector<double> &v, double &mean, double &var)
+    {
+        mean = 0;
+        for (double x : v)
+            mean += x;
+        mean /= v.size();
+        var = 0;
+        for (double x : v)
+            var += (x - mean) * (x - mean);
+        var /= max<size_t>(1, v.size() - 1);
+    };
+    double ma, va, mb, vb;
+    moments(a, ma, va);
+    moments(b, mb, vb);
+    double se = sqrt(va / a.size() + vb / b.size());
+    if (se == 0)
+    {
+        t = 0;
+        return (ma == mb) ? 1.0 : 0.0;
+    }
+    t = (ma - mb) / se;
+    return erfc(fabs(t) / sqrt(2.0));
+}
+
+/**
+ * Compares final ant and doodlebug counts, and their averages over the
+ * run, between reference and candidate across many seeds. Returns the
+ * smallest p-value of the four tests. A statistic with the same value
+ * in every run of both engines cannot tell them apart, so it is
+ * reported and left out.
+ */
+double compareStatistics(const Engine &cand, int size, int seeds, int steps, ostream &os)
+{
+    const char *names[4] = {"final ants", "final doodlebugs", "mean ants", "mean doodlebugs"};
+    vector<double> stats[2][4];
+    for (int s = 0; s < seeds; s++)
+    {
+        for (int e = 0; e < 2; e++)
+        {
+            World w(size);
+            w.seed(1000 + s * 2 + e); // independent streams per engine
+            w.initialize();
+            double sumAnts = 0, sumDoodles = 0;
+            int ants = 0, doodles = 0;
+            for (int i = 0; i < steps; i++)
+            {
+                if (e == 0)
+                    referenceStep(w);
+                else
+                    cand.step(w);
+                Census c = w.census();
+                ants = c.ants;
+                doodles = c.doodles;
+                sumAnts += ants;
+                sumDoodles += doodles;
+            }
+            stats[e][0].push_back(ants);
+            stats[e][1].push_back(doodles);
+            stats[e][2].push_back(sumAnts / steps);
+            stats[e][3].push_back(sumDoodles / steps);
+        }
+    }
+    double worst = 1.0;
+    for (int k = 0; k < 4; k++)
+    {
+        const vector<double> &a = stats[0][k], &b = stats[1][k];
+        double first = a.empty() ? 0 : a[0];
+        auto constant = [first](double x)
+        { return x == first; };
+        if (all_of(a.begin(), a.end(), constant) && all_of(b.begin(), b.end(), constant))
+        {
+            os << "    " << names[k] << ": always " << first << ", not compared\n";
+            continue;
+        }
+        double t;
+        double p = welchP(a, b, t);
+        os << "    " << names[k] << ": t = " << t << ", p = " << p << "\n";
+        worst = min(worst, p);
+    }
+    return worst;
+}
+
+/**
+ * Runs updateParallel from one seed with each thread count and checks
+ * that the checksums agree after every step
+ */
+bool threadCountInvariant(int size, unsigned seed, int steps, const vector<int> &threadCounts)
+{
+    vector<unique_ptr<World>> worlds;
+    for (size_t i = 0; i < threadCounts.size(); i++)
+    {
+        worlds.emplace_back(new World(size));
+        worlds.back()->seed(seed);
+        worlds.back()->setParallelGrain(16); // small enough to split every batch
+        worlds.back()->initialize(size * size / 3, size * size / 50);
+    }
+    for (int i = 0; i < steps; i++)
+    {
+        for (size_t k = 0; k < worlds.size(); k++)
+            worlds[k]->updateParallel(threadCounts[k]);
+        for (size_t k = 1; k < worlds.size(); k++)
+            if (worlds[k]->checksum() != worlds[0]->checksum())
+                return false;
+    }
+    return true;
+}
+
+/**
+ * ExtinctionOptions: how estimateExtinction samples each parameter point
+ */
+struct ExtinctionOptions
+{
+    int steps = 1000;          // T: extinct means no doodlebugs within T steps
+    double targetWidth = 0.1;  // a point is resolved once its interval is this narrow
+    double z = 1.96;           // 95% confidence
+    int batch = 16;            // seeds added to each unresolved point per round
+    int maxRuns = 2000;        // a point is also resolved after this many runs
+    int threads = 1;
+    uint64_t seed = 1;
+};
+
+/**
+ * ExtinctionEstimate: fraction of runs in which doodlebugs died out and
+ * its Wilson score interval
+ */
+struct ExtinctionEstimate
+{
+    int runs = 0, extinctions = 0;
+    double p = 0, low = 0, high = 1;
+    long steps = 0; // steps simulated for this point
+    bool resolved = false;
+};
+
+/**
+ * Wilson score interval for k successes in n trials
+ */
+static void wilsonInterval(int k, int n, double z, double &low, double &high)
+{
+    if (n == 0)
+    {
+        low = 0;
+        high = 1;
+        return;
+    }
+    double p = static_cast<double>(k) / n, z2n = z * z / n;
+    double center = (p + z2n / 2) / (1 + z2n);
+    double half = z / (1 + z2n) * sqrt(p * (1 - p) / n + z2n / (4 * n));
+    low = k == 0 ? 0 : max(0.0, center - half);
+    high = k == n ? 1 : min(1.0, center + half);
+}
+
+/**
+ * Estimates, for every parameter point (a function making a fresh world
+ * from a seed), the probability that doodlebugs die out within
+ * opts.steps steps. Rounds add opts.batch seeds to each point whose
+ * interval is still wider than opts.targetWidth; each run stops as soon
+ * as the doodlebugs are gone. The runs of a round share opts.threads
+ * workers that take the next run as they finish. Run i of point p always
+ * uses the same seed, so results do not depend on the thread count.
+ */
+vector<ExtinctionEstimate> estimateExtinction(const vector<function<unique_ptr<World>(unsigned)>> &points,
+                                              const ExtinctionOptions &opts)
+{
+    vector<ExtinctionEstimate> estimates(points.size());
+    RunOptions runOpts;
+    runOpts.stopWhen = [](World &w)
+    { return w.doodleCount() == 0; };
+    while (true)
+    {
+        vector<pair<size_t, int>> jobs; // (point, run index)
+        for (size_t p = 0; p < points.size(); p++)
+        {
+            const ExtinctionEstimate &e = estimates[p];
+            if (e.resolved)
+                continue;
+            for (int i = 0; i < opts.batch && e.runs + i < opts.maxRuns; i++)
+                jobs.push_back({p, e.runs + i});
+        }
+        if (jobs.empty())
+            break;
+
+        vector<int> died(jobs.size());
+        vector<long> taken(jobs.size());
+        atomic<size_t> next(0);
+        int workers = max(1, opts.threads);
+        parallelBands(workers, workers, [&](int, int, int)
+                      {
+            for (size_t j; (j = next++) < jobs.size();)
+            {
+                unsigned s = static_cast<unsigned>(counterRandom(opts.seed, jobs[j].second, jobs[j].first, 0));
+                unique_ptr<World> w = points[jobs[j].first](s);
+                taken[j] = w->doodleCount() == 0 ? 0 : w->run(opts.steps, runOpts);
+                died[j] = w->doodleCount() == 0;
+            } });
+
+        for (size_t j = 0; j < jobs.size(); j++)
+        {
+            ExtinctionEstimate &e = estimates[jobs[j].first];
+            e.runs++;
+            e.extinctions += died[j];
+            e.steps += taken[j];
+        }
+        for (ExtinctionEstimate &e : estimates)
+        {
+            if (e.resolved)
+                continue;
+            e.p = static_cast<double>(e.extinctions) / e.runs;
+            wilsonInterval(e.extinctions, e.runs, opts.z, e.low, e.high);
+            e.resolved = e.high - e.low <= opts.targetWidth || e.runs >= opts.maxRuns;
+        }
+    }
+    return estimates;
 }
 
 /**
- * Doodlebug::update(World&)
- * 1) Starve check
- * 2) Attempt to eat
- * 3) If no eat, move
- * 4) Breed if breedCount >= DOODLE_BREED
+ * --diff: checks every candidate engine against the reference, and
+ * that updateParallel does not depend on the thread count. Exit status
+ * is nonzero if any engine differs at the 0.1% level or the thread
+ * counts disagree.
  */
-void Doodlebug::update(World &w)
+int runDifferential()
 {
-    // 1) Starve check
-    if (starve())
+    // Doodlebugs outlive 200 steps from the default start in nearly
+    // every seed at this size, with either neighborhood, so every
+    // statistic varies
+    const int size = 40, steps = 200, seeds = 40;
+    bool anyFailed = false;
+    for (auto &cand : candidateEngines())
     {
-        w.deleteCell(getX(), getY());
-        return;
+        cout << cand.name << " (statistical)\n";
+        bool failed = compareStatistics(cand, size, seeds, steps, cout) < 0.001;
+        cout << (failed ? "    FAILED\n" : "    ok\n");
+        anyFailed = anyFailed || failed;
     }
 
-    bool ate = false;
-    Directions neighbors = w.getNeighbors(getX(), getY());
-    static random_device rd;
-    static mt19937 gen(rd());
-    shuffle(neighbors.begin(), neighbors.end(), gen);
+    cout << "World::updateParallel with 1, 8 and 64 threads\n";
+    bool same = true;
+    for (unsigned seed = 1; seed <= 2 && same; seed++)
+        same = threadCountInvariant(128, seed, 20, {1, 8, 64});
+    cout << (same ? "    identical\n" : "    FAILED: results depend on thread count\n");
+    return (anyFailed || !same) ? 1 : 0;
+}
 
-    // 2) Attempt to eat an adjacent Ant
-    for (auto &nbr : neighbors)
+/**
+ * Keeps the viewport inside the world after a pan or zoom
+ */
+void clampViewport(Viewport &v, const World &w)
+{
+    v.zoom = max(0, min(v.zoom, w.maxZoom()));
+    int blocks = ((w.getSize() - 1) >> v.zoom) + 1;
+    v.top = max(0, min(v.top, blocks - v.rows));
+    v.left = max(0, min(v.left, blocks - v.cols));
+}
+
+/**
+ * MultiView: several worlds stepped together (one thread each) and drawn
+ * side by side. Every panel shows the same viewport; the panels are
+ * written into one shared frame buffer, one line per screen row, and
+ * printed with a single write. Each panel reads only its visible blocks,
+ * so the cost depends on the viewport, not the world size.
+ */
+class MultiView
+{
+private:
+    vector<unique_ptr<World>> worlds;
+    vector<string> labels;
+    vector<char> frame;
+
+public:
+    static const int GAP = 3; // spaces between panels
+
+    /**
+     * Adds a panel. Its steps are what-ifs, so the world is detached
+     * from any event log it was copied with.
+     */
+    void add(unique_ptr<World> world, const string &label)
     {
-        int nx = nbr.first;
-        int ny = nbr.second;
-        Organism *occupant = w.getCell(nx, ny);
-        // Is occupant an Ant?
-        Ant *maybeAnt = dynamic_cast<Ant *>(occupant);
-        if (maybeAnt)
-        {
-            // Eat (remove occupant) and move
-            w.deleteCell(nx, ny);
-            w.setCell(nx, ny, this);
-            w.setCell(getX(), getY(), nullptr);
-            setPos(nx, ny);
-            ate = true;
-            starveCount = 0;
-            break;
-        }
+        world->setEventLog(nullptr);
+        worlds.push_back(move(world));
+        labels.push_back(label);
     }
 
-    // 3) If didn't eat, try to move
-    if (!ate)
+    size_t count() const { return worlds.size(); }
+
+    const World &world(size_t i) const { return *worlds[i]; }
+
+    /**
+     * Steps every world once, each on its own thread (threads > 0: each
+     * with the parallel engine on that many threads)
+     */
+    void step(int threads)
     {
-        shuffle(neighbors.begin(), neighbors.end(), gen);
-        bool moved = false;
-        for (auto &nbr : neighbors)
+        int n = static_cast<int>(worlds.size());
+        parallelBands(n, n, [&](int, int begin, int end)
+                      {
+            for (int k = begin; k < end; k++)
+            {
+                if (threads > 0)
+                    worlds[k]->updateParallel(threads);
+                else
+                    worlds[k]->update();
+            } });
+    }
+
+    /**
+     * Draws the viewport of every world, with a label line above and a
+     * census line below each panel
+     */
+    void render(ostream &os, const Viewport &v)
+    {
+        int size = worlds.empty() ? 0 : worlds[0]->getSize();
+        int blocks = ((size - 1) >> v.zoom) + 1;
+        int rows = max(0, min(blocks, v.top + v.rows) - v.top);
+        int cols = max(0, min(blocks, v.left + v.cols) - v.left);
+        int panel = max(2 * cols, 24);
+        int width = static_cast<int>(worlds.size()) * (panel + GAP);
+        int lines = rows + 2;
+        frame.assign(static_cast<size_t>(lines) * (width + 1), ' ');
+        for (int l = 0; l < lines; l++)
+            frame[static_cast<size_t>(l) * (width + 1) + width] = '\n';
+
+        auto text = [&](int line, int column, const string &s)
         {
-            int nx = nbr.first;
-            int ny = nbr.second;
-            if (!w.getCell(nx, ny))
+            s.copy(&frame[static_cast<size_t>(line) * (width + 1) + column], min<size_t>(s.size(), panel));
+        };
+        for (size_t k = 0; k < worlds.size(); k++)
+        {
+            const World &w = *worlds[k];
+            int left = static_cast<int>(k) * (panel + GAP);
+            text(0, left, labels[k] + " @ " + to_string(w.getAge() + 1));
+            for (int r = 0; r < rows; r++)
             {
-                w.setCell(nx, ny, this);
-                w.setCell(getX(), getY(), nullptr);
-                setPos(nx, ny);
-                moved = true;
-                break;
+                char *out = &frame[static_cast<size_t>(r + 1) * (width + 1) + left];
+                for (int c = 0; c < cols; c++)
+                    out[2 * c] = w.glyph(v.top + r, v.left + c, v.zoom);
             }
+            text(rows + 1, left, to_string(w.antCount()) + " ants, " + to_string(w.doodleCount()) + " doodlebugs");
         }
-        // If we didn't eat, increment starveCount
-        // even if we moved. The doodlebug starves if it doesn't eat
-        // for DOODLE_STARVE turns.
-        starveCount++;
+        os.write(frame.data(), static_cast<streamsize>(frame.size()));
     }
+};
 
-    // 4) Breed
-    incBreed();
-    if (getBreedCount() >= DOODLE_BREED)
+/**
+ * Speculator: while the user reads a frame, a background thread steps a
+ * copy of the world ahead into a bounded queue of future worlds, so the
+ * next step is usually ready the moment it is asked for. The copies use
+ * the same engine and carry the same random state, so a queued world is
+ * exactly what stepping the shown one would give. stop() discards
+ * whatever is queued.
+ */
+class Speculator
+{
+private:
+    mutex lock;
+    condition_variable changed;
+    deque<unique_ptr<World>> ready;
+    size_t capacity = 0;
+    bool stopping = false;
+    thread worker;
+
+    void run(unique_ptr<World> cursor, int threads)
     {
-        shuffle(neighbors.begin(), neighbors.end(), gen);
-        for (auto &nbr : neighbors)
+        while (true)
         {
-            int nx = nbr.first;
-            int ny = nbr.second;
-            if (!w.getCell(nx, ny))
-            {
-                w.createDoodlebug(nx, ny);
-                break;
-            }
+            if (threads > 0)
+                cursor->updateParallel(threads);
+            else
+                cursor->update();
+            unique_ptr<World> frame(new World(*cursor));
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]
+                         { return stopping || ready.size() < capacity; });
+            if (stopping)
+                return;
+            ready.push_back(move(frame));
+            changed.notify_all();
         }
-        resetBreed();
+    }
+
+public:
+    ~Speculator() { stop(); }
+
+    bool running() const { return worker.joinable(); }
+
+    /**
+     * Starts stepping a copy of from (threads > 0: the parallel engine),
+     * keeping at most frames steps queued
+     */
+    void start(const World &from, size_t frames, int threads)
+    {
+        stop();
+        unique_ptr<World> cursor(new World(from));
+        cursor->setEventLog(nullptr);
+        capacity = max<size_t>(1, frames);
+        stopping = false;
+        worker = thread(&Speculator::run, this, move(cursor), threads);
+    }
+
+    /**
+     * The world one step after the last one handed out (or the start)
+     */
+    unique_ptr<World> next()
+    {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&]
+                     { return !ready.empty(); });
+        unique_ptr<World> frame = move(ready.front());
+        ready.pop_front();
+        changed.notify_all();
+        return frame;
+    }
+
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+        ready.clear();
+    }
+};
+
+/**
+ * History: copies of the world every `every` steps (keyframes), within a
+ * memory budget measured with World::footprint (the lineage chunks that
+ * copies share are counted once, by the live world). Stepping is
+ * deterministic, so any earlier step is its nearest keyframe stepped
+ * forward; seeking backwards also keeps the steps it replays, so
+ * stepping back one at a time stays instant. Over budget, the replayed
+ * steps farthest from the one just shown go first, then the oldest
+ * keyframes.
+ */
+class History
+{
+private:
+    struct Frame
+    {
+        unique_ptr<World> world;
+        size_t bytes;
+    };
+    map<int, Frame> frames; // by age
+    size_t bytes = 0;       // sum of the frames' footprints
+    size_t budget = 256 << 20;
+    int every = 16;
+    int newest = 0; // steps from here on have not been taken (or logged) yet
+
+    void evict(int keepNear)
+    {
+        while (bytes > budget && frames.size() > 1)
+        {
+            auto victim = frames.end();
+            for (auto it = frames.begin(); it != frames.end(); ++it)
+                if (it->first % every != 0 &&
+                    (victim == frames.end() || abs(it->first - keepNear) > abs(victim->first - keepNear)))
+                    victim = it;
+            if (victim == frames.end())
+                victim = frames.begin();
+            bytes -= victim->second.bytes;
+            frames.erase(victim);
+        }
+    }
+
+    void store(const World &w)
+    {
+        Frame frame = {unique_ptr<World>(new World(w)), w.footprint()};
+        frame.world->setEventLog(nullptr);
+        bytes += frame.bytes;
+        frames[w.getAge()] = move(frame);
+        evict(w.getAge());
+    }
+
+public:
+    /**
+     * Forgets every frame and spaces the keyframes so that a budget of
+     * about budgetBytes covers some 4096 steps of worlds like w
+     */
+    void reset(const World &w, size_t budgetBytes = 256 << 20)
+    {
+        clear();
+        budget = budgetBytes;
+        size_t fit = max<size_t>(4, budget / w.footprint());
+        every = static_cast<int>(min<size_t>(256, max<size_t>(4, 4096 / fit)));
+        newest = w.getAge();
+    }
+
+    void clear()
+    {
+        frames.clear();
+        bytes = 0;
+    }
+
+    bool empty() const { return frames.empty(); }
+
+    size_t count() const { return frames.size(); }
+
+    int oldest() const { return frames.empty() ? 0 : frames.begin()->first; }
+
+    /**
+     * Age of the newest step taken so far; stepping again up to it
+     * replays steps that were already logged
+     */
+    int newestAge() const { return newest; }
+
+    /**
+     * Keeps a copy of w if it is at a keyframe step (or always, if forced)
+     */
+    void record(const World &w, bool force = false)
+    {
+        newest = max(newest, w.getAge());
+        if ((force || w.getAge() % every == 0) && !frames.count(w.getAge()))
+            store(w);
+    }
+
+    /**
+     * Sets w to its state at age target (threads > 0: stepped with the
+     * parallel engine). Replayed steps are not logged again; steps past
+     * the newest one taken so far go to w's event log. Returns false if
+     * target is before the oldest frame.
+     */
+    bool seek(World &w, int target, int threads)
+    {
+        if (target < 0)
+            return false;
+        if (target == w.getAge())
+            return true;
+        auto after = frames.upper_bound(target);
+        const World *start = (after == frames.begin()) ? nullptr : prev(after)->second.world.get();
+        if (target > w.getAge() && (!start || start->getAge() <= w.getAge()))
+            start = &w;
+        if (!start)
+            return false;
+
+        bool backwards = target < w.getAge();
+        EventLog *log = w.getEventLog();
+        newest = max(newest, w.getAge());
+        World cur(*start);
+        cur.setEventLog(log, newest);
+        while (cur.getAge() < target)
+        {
+            if (threads > 0)
+                cur.updateParallel(threads);
+            else
+                cur.update();
+            record(cur, backwards && cur.getAge() < target);
+        }
+        w = move(cur);
+        evict(target);
+        return true;
+    }
+};
+
+/**
+ * Prints cluster count, largest and mean size and the size distribution
+ */
+void printClusters(const ClusterStats &stats)
+{
+    const pair<const char *, const ClusterStats::Species *> species[] = {
+        {"ants", &stats.ants}, {"doodlebugs", &stats.doodles}};
+    for (const auto &s : species)
+    {
+        cout << "  " << s.first << ": " << s.second->clusters << " clusters, largest "
+             << s.second->largest << ", mean " << s.second->meanSize() << "; sizes";
+        for (size_t bin = 0; bin < s.second->sizeBins.size(); bin++)
+            if (s.second->sizeBins[bin])
+                cout << " " << (1L << bin) << "+:" << s.second->sizeBins[bin];
+        cout << "\n";
+    }
+}
+
+/**
+ * Prints the spectral peaks, then the radial spectra as a table of
+ * wavenumber, wavelength and power (or, compactly, as one line each)
+ */
+void printSpectrum(const SpectrumStats &stats, bool table)
+{
+    cout << "  " << stats.blocks << " x " << stats.blocks << " blocks of " << stats.blockSize
+         << " x " << stats.blockSize << " cells\n";
+    const pair<const char *, const SpectrumStats::Peak *> peaks[] = {
+        {"ants", &stats.antPeak}, {"doodlebugs", &stats.doodlePeak}};
+    for (const auto &p : peaks)
+        cout << "  " << p.first << " peak: wavevector (" << p.second->kx << ", " << p.second->ky
+             << "), wavelength " << p.second->wavelength << " cells, angle " << p.second->angle
+             << " degrees, power " << p.second->power << "\n";
+    if (table)
+    {
+        cout << "  k  wavelength  ant power  doodlebug power\n";
+        for (size_t k = 1; k < stats.antPower.size(); k++)
+            cout << "  " << k << "  " << static_cast<double>(stats.blocks) * stats.blockSize / k << "  "
+                 << stats.antPower[k] << "  " << stats.doodlePower[k] << "\n";
+        return;
+    }
+    const pair<const char *, const vector<double> *> spectra[] = {
+        {"ants", &stats.antPower}, {"doodlebugs", &stats.doodlePower}};
+    for (const auto &s : spectra)
+    {
+        cout << "  " << s.first << " spectrum:";
+        for (size_t k = 1; k < s.second->size(); k++)
+            cout << " " << (*s.second)[k];
+        cout << "\n";
+    }
+}
+
+/**
+ * Prints the population cycle estimate
+ */
+void printOscillation(const OscillationStats &s, int window)
+{
+    if (!s.warm)
+    {
+        cout << "  cycle: still filling the " << window << "-step window\n";
+        return;
+    }
+    const pair<const char *, const double *> species[] = {
+        {"ants", &s.antPeriod}, {"doodlebugs", &s.doodlePeriod}};
+    const double amplitudes[] = {s.antAmplitude, s.doodleAmplitude};
+    const double strengths[] = {s.antStrength, s.doodleStrength};
+    for (int i = 0; i < 2; i++)
+    {
+        cout << "  " << species[i].first << ": ";
+        if (*species[i].second > 0)
+            cout << "period " << *species[i].second << " steps (correlation " << strengths[i] << "), ";
+        else
+            cout << "no cycle, ";
+        cout << "amplitude " << amplitudes[i] << "\n";
+    }
+    if (s.antPeriod > 0)
+        cout << "  doodlebugs trail ants by " << s.lag << " steps (" << s.lagDegrees << " degrees); "
+             << (s.stationary ? "stationary" : "not yet stationary") << "\n";
+}
+
+/**
+ * Pans (w/a/s/d) or zooms (+/-) the viewport; false for other input
+ */
+bool moveViewport(const string &input, Viewport &view, const World &w)
+{
+    if (input == "w" || input == "a" || input == "s" || input == "d")
+    {
+        int rowStep = max(1, view.rows / 2);
+        int colStep = max(1, view.cols / 2);
+        if (input == "w")
+            view.top -= rowStep;
+        else if (input == "s")
+            view.top += rowStep;
+        else if (input == "a")
+            view.left -= colStep;
+        else
+            view.left += colStep;
+        clampViewport(view, w);
+        return true;
+    }
+    if (input == "+" || input == "-")
+    {
+        // Keep the block at the screen centre in place
+        int cx = (view.top + view.rows / 2) << view.zoom;
+        int cy = (view.left + view.cols / 2) << view.zoom;
+        view.zoom += (input == "-") ? 1 : -1;
+        clampViewport(view, w);
+        view.top = (cx >> view.zoom) - view.rows / 2;
+        view.left = (cy >> view.zoom) - view.cols / 2;
+        clampViewport(view, w);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Runs copies of w side by side, the first as it is and one more per
+ * variant with that setting toggled (scent, food, evolve, stochastic),
+ * until the user types 'q'. The copies share w's state and random seed.
+ */
+void compareWorlds(const World &w, const vector<string> &variants, bool parallel)
+{
+    MultiView view;
+    view.add(unique_ptr<World>(new World(w)), "as is");
+    for (const string &name : variants)
+    {
+        unique_ptr<World> copy(new World(w));
+        bool on;
+        if (name == "scent")
+            copy->setScent(on = !w.hasScent());
+        else if (name == "food")
+            copy->setFood(on = !w.hasFood());
+        else if (name == "evolve")
+            copy->setEvolution(on = !w.isEvolving());
+        else if (name == "stochastic")
+            copy->setStochasticBreeding(on = !w.isBreedingStochastic());
+        else
+        {
+            cout << "Unknown setting " << name << " (scent, food, evolve or stochastic)\n";
+            return;
+        }
+        view.add(move(copy), name + (on ? " on" : " off"));
+    }
+    // 40 cells of two characters each fit an 80 column terminal
+    int cols = max(4, 40 / static_cast<int>(view.count()));
+    Viewport v = {0, 0, min(w.getSize(), 40), min(w.getSize(), cols), 0};
+    while (true)
+    {
+        view.render(cout, v);
+        cout << "Press Enter to step all, w/a/s/d and +/- to move, 'q' to go back.\n";
+        string input;
+        if (!std::getline(cin, input) || input == "q")
+            return;
+        if (!moveViewport(input, v, view.world(0)))
+            view.step(parallel ? max(1, defaultBands() / static_cast<int>(view.count())) : 0);
     }
 }
 
 /**
  * main
  */
-int main()
+int main(int argc, char *argv[])
 {
+    if (argc > 1 && string(argv[1]) == "--diff")
+        return runDifferential();
+
     World w(20);
-    w.initialize();
+    if (argc > 1)
+    {
+        // Start from a text map, e.g. one saved from this program's output
+        if (!w.loadMap(argv[1]))
+        {
+            cerr << "Could not load map " << argv[1] << "\n";
+            return 1;
+        }
+    }
+    else
+    {
+        w.initialize();
+    }
+    unique_ptr<EventLog> log;
+    bool parallel = false;
+    // Steps computed ahead while waiting for input; off while logging or
+    // validating, whose output belongs to the step being shown
+    Speculator ahead;
+    int aheadFrames = 8;
+    History history;
+
+    // 40 cells of two characters each fit an 80 column terminal
+    Viewport view = {0, 0, min(w.getSize(), 40), min(w.getSize(), 40), 0};
 
     while (true)
     {
-        cout << w << endl;
-        cout << "Press Enter to continue, or type 'q' (then Enter) to quit.\n";
+        w.render(cout, view);
+        cout << endl;
+        cout << "Press Enter to continue, or type 'q' (then Enter) to quit, 'help' for commands.\n";
+        if (history.empty())
+            history.reset(w);
+        history.record(w, history.empty());
+        // Steps up to the newest one taken were logged when first taken
+        w.setEventLog(log.get(), history.newestAge());
+        const ValidationOptions &checks = w.getValidation();
+        bool checking = checks.sampleCells > 0 || checks.sampleOrgs > 0 || checks.fullEvery > 0;
+        if (!ahead.running() && aheadFrames > 0 && !log && !checking)
+        {
+            // Keep the queued copies within about 256 MB
+            size_t frames = max<size_t>(1, min<size_t>(aheadFrames, (256 << 20) / w.footprint()));
+            ahead.start(w, frames, parallel ? defaultBands() : 0);
+        }
         string input;
         if (!std::getline(cin, input))
         {
@@ -436,7 +5164,287 @@ int main()
         {
             break;
         }
-        w.update();
+        // Panning and zooming keep the world; anything else but a plain
+        // step may read or change it, so the speculation is dropped
+        bool viewOnly = input == "w" || input == "a" || input == "s" || input == "d" ||
+                        input == "+" || input == "-";
+        if (!input.empty() && !viewOnly)
+            ahead.stop();
+        // Commands that change how the world evolves (or replace it)
+        // make the recorded steps useless
+        if (input == "scent" || input == "food" || input == "evolve" || input == "stochastic" ||
+            input == "parallel" || input.compare(0, 4, "map ") == 0 || input.compare(0, 5, "load ") == 0 ||
+            input.compare(0, 6, "cycle ") == 0)
+            history.clear();
+        if (input == "back" || input.compare(0, 5, "back ") == 0 || input.compare(0, 5, "goto ") == 0 ||
+            input.compare(0, 8, "forward ") == 0)
+        {
+            istringstream args(input);
+            string command;
+            int n = 1;
+            args >> command >> n;
+            int target = command == "goto" ? n - 1 : command == "back" ? w.getAge() - n : w.getAge() + n;
+            if (!history.seek(w, target, parallel ? defaultBands() : 0))
+                cout << "History starts at iteration " << history.oldest() + 1 << "\n";
+            continue;
+        }
+        if (input == "ahead" || input.compare(0, 6, "ahead ") == 0)
+        {
+            if (input.size() > 6)
+                aheadFrames = max(0, atoi(input.c_str() + 6));
+            cout << "Computing " << aheadFrames << " steps ahead" << (aheadFrames ? "" : " (off)") << "\n";
+            continue;
+        }
+        if (moveViewport(input, view, w))
+            continue;
+        if (input.compare(0, 5, "save ") == 0)
+        {
+            if (!w.saveCheckpoint(input.substr(5)))
+                cout << "Could not write " << input.substr(5) << "\n";
+            continue;
+        }
+        if (input == "lineage")
+        {
+            auto living = w.livingByFounder();
+            const LineageTable &table = w.getLineage();
+            if (table.full())
+            {
+                cout << "Lineage stopped after " << table.size() << " births: organism IDs ran out\n";
+                continue;
+            }
+            auto born = table.descendantCounts();
+            map<uint32_t, uint32_t> bornBy(born.begin(), born.end());
+            cout << table.size() << " organisms recorded, " << living.size() << " lineages alive\n";
+            for (size_t i = 0; i < living.size() && i < 10; i++)
+                cout << "  founder " << living[i].first << ": " << living[i].second << " living, "
+                     << bornBy[living[i].first] << " descendants born\n";
+            continue;
+        }
+        if (input.compare(0, 4, "log ") == 0)
+        {
+            w.setEventLog(nullptr);
+            log.reset(new EventLog(input.substr(4)));
+            if (!log->good())
+            {
+                cout << "Could not write " << input.substr(4) << "\n";
+                log.reset();
+            }
+            w.setEventLog(log.get());
+            continue;
+        }
+        if (input == "help")
+        {
+            cout << "  w/a/s/d            pan the view\n"
+                 << "  + / -              zoom in / out\n"
+                 << "  save <file>        write a compressed checkpoint\n"
+                 << "  load <file>        restore a checkpoint\n"
+                 << "  map <file>         load a text map\n"
+                 << "  log <file>         record births, deaths and predation\n"
+                 << "  lineage            founders with the most living descendants\n"
+                 << "  census             population, occupancy and clustering\n"
+                 << "  check              full grid/organism consistency check\n"
+                 << "  validate <c> <o> <n>  check c cells and o organisms each step, all every n\n"
+                 << "  parallel           toggle the deterministic multi-threaded engine\n"
+                 << "  run <n> [k] [clusters] [spectrum] [cycle] [steady]  take n steps (until\n"
+                 << "                     extinction, or a stationary cycle with 'steady'),\n"
+                 << "                     printing counts (and the chosen analyses) every k\n"
+                 << "  extinct <t> [w] [a d]  chance doodlebugs die out within t steps (from a ants,\n"
+                 << "                     d doodlebugs), sampled until the 95% interval is w wide\n"
+                 << "  clusters           cluster count, largest and size distribution per species\n"
+                 << "  spectrum [l]       radial density power spectra over 2^l-cell blocks\n"
+                 << "  cycle [w]          population cycle period, amplitude and lag (w: restart\n"
+                 << "                     with a w-step window)\n"
+                 << "  scent              toggle doodlebug scent that ants avoid\n"
+                 << "  food               toggle regrowing food that ants need to breed\n"
+                 << "  evolve             toggle mutation of breed/starve traits at birth\n"
+                 << "  traits             mean and variance of each species' traits\n"
+                 << "  stochastic         toggle breeding at random (mean gap = breed limit)\n"
+                 << "  timings            time spent per phase since the last 'timings'\n"
+                 << "  ahead [n]          steps to compute ahead while waiting (0: off)\n"
+                 << "  back [k]           go back k steps (default 1)\n"
+                 << "  forward <k>        go forward k steps\n"
+                 << "  goto <n>           go to iteration n\n"
+                 << "  compare <s>...     run copies side by side with settings s toggled\n";
+            continue;
+        }
+        if (input == "census")
+        {
+            Census c = w.census();
+            cout << c.ants << " ants, " << c.doodles << " doodlebugs, "
+                 << 100 * c.occupancy() << "% occupied\n"
+                 << "mean same-species neighbors: ants " << c.antClustering()
+                 << ", doodlebugs " << c.doodleClustering() << "; "
+                 << c.mixedPairs << " ant/doodlebug contacts\n";
+            continue;
+        }
+        if (input == "cycle" || input.compare(0, 6, "cycle ") == 0)
+        {
+            if (input.size() > 6)
+                w.setOscillationWindow(atoi(input.c_str() + 6));
+            printOscillation(w.oscillationStats(), w.getOscillationWindow());
+            continue;
+        }
+        if (input.compare(0, 8, "extinct ") == 0)
+        {
+            ExtinctionOptions opts;
+            int ants = w.antCount(), doodles = w.doodleCount();
+            istringstream args(input.substr(8));
+            args >> opts.steps >> opts.targetWidth >> ants >> doodles;
+            opts.threads = defaultBands();
+            opts.seed = static_cast<uint64_t>(time(nullptr));
+            int size = w.getSize();
+            bool scent = w.hasScent(), food = w.hasFood(), evolve = w.isEvolving(),
+                 stochastic = w.isBreedingStochastic();
+            vector<function<unique_ptr<World>(unsigned)>> points = {[=](unsigned s)
+            {
+                unique_ptr<World> world(new World(size));
+                world->seed(s);
+                world->setScent(scent);
+                world->setFood(food);
+                world->setEvolution(evolve);
+                world->setStochasticBreeding(stochastic);
+                world->initialize(ants, doodles);
+                return world;
+            }};
+            ExtinctionEstimate e = estimateExtinction(points, opts)[0];
+            cout << "P(doodlebugs extinct within " << opts.steps << " steps from " << ants << " ants, "
+                 << doodles << " doodlebugs) = " << e.p << ", 95% interval [" << e.low << ", " << e.high << "] from " << e.runs << " runs\n";
+            continue;
+        }
+        if (input == "clusters")
+        {
+            printClusters(w.clusters());
+            continue;
+        }
+        if (input == "spectrum" || input.compare(0, 9, "spectrum ") == 0)
+        {
+            int level = atoi(input.c_str() + 8);
+            printSpectrum(w.spectrum(level), true);
+            continue;
+        }
+        if (input.compare(0, 4, "run ") == 0)
+        {
+            RunOptions opts;
+            int steps = 0;
+            istringstream args(input.substr(4));
+            args >> steps >> opts.sampleEvery;
+            set<string> reports;
+            for (string name; args >> name;)
+                reports.insert(name);
+            opts.threads = parallel ? defaultBands() : 0;
+            opts.stopOnExtinction = true;
+            opts.stopWhenStationary = reports.count("steady") > 0;
+            opts.onSample = [&reports](World &w)
+            {
+                cout << "iteration " << w.getAge() << ": " << w.antCount() << " ants, "
+                     << w.doodleCount() << " doodlebugs\n";
+                if (reports.count("clusters"))
+                    printClusters(w.clusters());
+                if (reports.count("spectrum"))
+                    printSpectrum(w.spectrum(), false);
+                if (reports.count("cycle"))
+                    printOscillation(w.oscillationStats(), w.getOscillationWindow());
+            };
+            int done = w.run(steps, opts);
+            if (done < steps)
+                cout << "Stopped after " << done << " steps: "
+                     << (w.antCount() == 0 || w.doodleCount() == 0 ? "a species died out" : "the cycle is stationary")
+                     << "\n";
+            continue;
+        }
+        if (input.compare(0, 8, "compare ") == 0)
+        {
+            istringstream args(input.substr(8));
+            vector<string> variants;
+            for (string name; args >> name;)
+                variants.push_back(name);
+            compareWorlds(w, variants, parallel);
+            continue;
+        }
+        if (input == "scent")
+        {
+            w.setScent(!w.hasScent());
+            cout << (w.hasScent() ? "Scent on\n" : "Scent off\n");
+            continue;
+        }
+        if (input == "food")
+        {
+            w.setFood(!w.hasFood());
+            cout << (w.hasFood() ? "Food on\n" : "Food off\n");
+            continue;
+        }
+        if (input == "evolve")
+        {
+            w.setEvolution(!w.isEvolving());
+            cout << (w.isEvolving() ? "Evolution on\n" : "Evolution off\n");
+            continue;
+        }
+        if (input == "stochastic")
+        {
+            w.setStochasticBreeding(!w.isBreedingStochastic());
+            cout << (w.isBreedingStochastic() ? "Stochastic breeding on\n" : "Stochastic breeding off\n");
+            continue;
+        }
+        if (input == "traits")
+        {
+            TraitSummary a = w.traitSummary(false), d = w.traitSummary(true);
+            cout << a.count << " ants: breed " << a.breedMean << " (variance " << a.breedVariance << ")\n"
+                 << d.count << " doodlebugs: breed " << d.breedMean << " (variance " << d.breedVariance
+                 << "), starve " << d.starveMean << " (variance " << d.starveVariance << ")\n";
+            continue;
+        }
+        if (input == "timings")
+        {
+            const PhaseTimings &t = w.getTimings();
+            double steps = max(1L, t.steps);
+            cout << t.steps << " steps, ms per step: engine " << t.engineMs / steps
+                 << ", scent " << t.scentMs / steps << ", food " << t.foodMs / steps << ", validation " << t.validateMs / steps << "\n";
+            w.resetTimings();
+            continue;
+        }
+        if (input == "parallel")
+        {
+            parallel = !parallel;
+            cout << (parallel ? "Parallel engine on\n" : "Parallel engine off\n");
+            continue;
+        }
+        if (input == "check")
+        {
+            cout << w.validate(true) << " invariant violations\n";
+            continue;
+        }
+        if (input.compare(0, 9, "validate ") == 0)
+        {
+            // validate <cells> <organisms> <full check every N steps>
+            ValidationOptions opts;
+            istringstream args(input.substr(9));
+            args >> opts.sampleCells >> opts.sampleOrgs >> opts.fullEvery;
+            w.setValidation(opts);
+            continue;
+        }
+        if (input.compare(0, 4, "map ") == 0)
+        {
+            if (!w.loadMap(input.substr(4)))
+                cout << "Could not load map " << input.substr(4) << "\n";
+            clampViewport(view, w);
+            continue;
+        }
+        if (input.compare(0, 5, "load ") == 0)
+        {
+            if (!w.loadCheckpoint(input.substr(5)))
+                cout << "Could not load " << input.substr(5) << "\n";
+            clampViewport(view, w);
+            continue;
+        }
+        if (ahead.running())
+        {
+            unique_ptr<World> next = ahead.next();
+            w = move(*next);
+        }
+        else if (parallel)
+            w.updateParallel(defaultBands());
+        else
+            w.update();
     }
 
     return 0;